@@ -0,0 +1,213 @@
+/* RCX_Alloc.h
+ *
+ * Allocators for the RAM between __arena_start, __end unless the
+ * program is part of a bundle, and the stack, see rcx.lds.
+ *
+ * The arena hands out memory from the bottom up and frees it only all
+ * at once back to a mark, for buffers that live as long as the program
+ * or as one phase of it:
+ *
+ *   log = arena_alloc(512);
+ *
+ * The pools hand out blocks of POOL_CLASSES fixed sizes, taken from
+ * the arena by alloc_init, for objects that come and go such as
+ * messages. The size of each class and the number of blocks are set
+ * at compile time; define POOL_SIZE_n and POOL_COUNT_n before
+ * including this file to change them. A count of 0 leaves a class
+ * out. Sizes above POOL_SIZE_3 have no class, POOL_NONE, for which
+ * pool_alloc returns 0. pool_alloc and pool_free take constant time
+ * and may be called from interrupt handlers:
+ *
+ *   msg = pool_alloc(POOL_CLASS(sizeof(struct msg)));
+ *   ...
+ *   pool_free(msg);
+ *
+ * arena_high and pool_high are the most ever used, to size the
+ * buffers and pools of a finished program.
+ */
+
+#ifndef RCX_ALLOC_H
+#define RCX_ALLOC_H
+
+#include "RCX_H8.h"
+
+#define ALLOC_STACK     0x400           /* bytes left to the stack      */
+
+#ifndef POOL_SIZE_0
+#define POOL_SIZE_0     8
+#endif
+#ifndef POOL_SIZE_1
+#define POOL_SIZE_1     16
+#endif
+#ifndef POOL_SIZE_2
+#define POOL_SIZE_2     32
+#endif
+#ifndef POOL_SIZE_3
+#define POOL_SIZE_3     64
+#endif
+#ifndef POOL_COUNT_0
+#define POOL_COUNT_0    16
+#endif
+#ifndef POOL_COUNT_1
+#define POOL_COUNT_1    8
+#endif
+#ifndef POOL_COUNT_2
+#define POOL_COUNT_2    4
+#endif
+#ifndef POOL_COUNT_3
+#define POOL_COUNT_3    2
+#endif
+#define POOL_CLASSES    4
+#define POOL_NONE       POOL_CLASSES
+
+/* Smallest class for size bytes, POOL_NONE if too large; constant if
+ * size is
+ */
+#define POOL_CLASS(size)                                \
+  ((size) <= POOL_SIZE_0 ? 0 :                          \
+   (size) <= POOL_SIZE_1 ? 1 :                          \
+   (size) <= POOL_SIZE_2 ? 2 :                          \
+   (size) <= POOL_SIZE_3 ? 3 : POOL_NONE)
+
+/* From rcx.lds */
+extern byte _arena_start[];
+extern byte _stack[];
+
+byte *arena_base;                       /* above the pools              */
+byte *arena_top;                        /* next free byte               */
+byte *arena_limit;
+byte *arena_max;                        /* highest arena_top            */
+
+/* A block on the free list holds the address of the next one */
+struct pool { byte *start;
+              byte *end;
+              void *free;
+              uint16 size;
+              byte used;
+              byte high;
+            };
+
+struct pool pool[POOL_CLASSES];
+
+/* size bytes from the arena, word aligned. Returns 0 if the arena is
+ * full.
+ */
+void *arena_alloc (uint16 size)
+{
+  byte *p = arena_top;
+
+  if (p >= arena_limit || size > (uint16)(arena_limit - p))
+    return 0;
+  arena_top = p + ((size + 1) & ~1);
+  if (arena_top > arena_max)
+    arena_max = arena_top;
+  return p;
+}
+
+/* arena_release(mark) frees everything allocated after
+ * mark = arena_mark().
+ */
+static inline byte *arena_mark (void)
+{
+  return arena_top;
+}
+
+static inline void arena_release (byte *mark)
+{
+  arena_top = mark;
+}
+
+/* Free arena bytes */
+static inline uint16 arena_free (void)
+{
+  return arena_top < arena_limit ? arena_limit - arena_top : 0;
+}
+
+/* Most arena bytes ever used, besides the pools */
+static inline uint16 arena_high (void)
+{
+  return arena_max - arena_base;
+}
+
+void pool_init (byte class, uint16 size, byte count)
+{
+  struct pool *p = &pool[class];
+  byte *b;
+
+  p->size = size;
+  p->used = p->high = 0;
+  p->free = 0;
+  p->start = p->end = arena_alloc(size * count);
+  if (p->start == 0)
+    return;
+  p->end = p->start + size * count;
+
+  for (b = p->end; b != p->start; ) {
+    b -= size;
+    *(void **)b = p->free;
+    p->free = b;
+  }
+}
+
+/* Set up the arena and the pools. Call before any allocation. */
+void alloc_init (void)
+{
+  arena_top = (byte *)(((word)_arena_start + 1) & ~1);
+  arena_limit = _stack - ALLOC_STACK;
+  arena_max = arena_top;
+
+  pool_init(0, POOL_SIZE_0, POOL_COUNT_0);
+  pool_init(1, POOL_SIZE_1, POOL_COUNT_1);
+  pool_init(2, POOL_SIZE_2, POOL_COUNT_2);
+  pool_init(3, POOL_SIZE_3, POOL_COUNT_3);
+
+  arena_base = arena_max = arena_top;
+}
+
+/* A block of class. Returns 0 if all are in use or class is
+ * POOL_NONE.
+ */
+void *pool_alloc (byte class)
+{
+  struct pool *p = &pool[class];
+  void *b;
+  byte ccr;
+
+  if (class >= POOL_CLASSES)
+    return 0;
+  ccr = irq_save();
+  if ((b = p->free) != 0) {
+    p->free = *(void **)b;
+    if (++p->used > p->high)
+      p->high = p->used;
+  }
+  irq_restore(ccr);
+  return b;
+}
+
+/* Free a block from pool_alloc. Other pointers are ignored. */
+void pool_free (void *b)
+{
+  struct pool *p;
+  byte ccr;
+
+  for (p = pool; p < &pool[POOL_CLASSES]; p++)
+    if ((byte *)b >= p->start && (byte *)b < p->end)
+      break;
+  if (p == &pool[POOL_CLASSES])
+    return;
+
+  ccr = irq_save();
+  *(void **)b = p->free;
+  p->free = b;
+  p->used--;
+  irq_restore(ccr);
+}
+
+/* Most blocks of class ever in use at once */
+static inline byte pool_high (byte class)
+{
+  return pool[class].high;
+}
+
+#endif /* RCX_ALLOC_H */
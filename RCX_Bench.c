@@ -0,0 +1,63 @@
+/*
+ *  RCX_Bench.c
+ *
+ *  Reads the results of the benchmark program bench.c from the RCX
+ *  and prints them as a table.
+ *
+ *  Under UNIX systems like IRIX, Linux, and Solaris, this program compiles
+ *  with gcc RCX_Bench.c -o rcxbench.
+ *
+ *  Usage:
+ *
+ *     rcxbench
+ *
+ *  The RS232 port connected to the infrared transmitter/receiver is
+ *  found as described in RCX_Tower.h. Set the RCX_IR environment
+ *  variable to the name of the port to skip discovery.
+ *------------------------------------------------------------------------
+ */
+
+#include <stdio.h>      /* printf                                        */
+#include <stdlib.h>     /* exit                                          */
+
+#include "RCX_IR.h"     /* IR_open, IR_request                           */
+
+#define BENCH_REQUEST  0x86     /* request of bench.c                    */
+#define PHI_MHZ        16.0     /* states per us                         */
+
+int main(int argc, char * argv[])
+{
+    byte req[2], reply[IR_MAXSIZE];
+    unsigned long states;
+    int fd, index, count, calls, n;
+
+    if (argc != 1) {
+        printf("usage: %s\n", argv[0]);
+        exit(1);
+    }
+
+    fd = IR_open();
+
+    printf("%3s  %-12s %6s %10s %10s\n", "#", "routine", "calls",
+           "states", "us");
+    count = 1;
+    for (index = 0; index < count; index++) {
+        req[0] = BENCH_REQUEST | (index & 1) << 3;
+        req[1] = index;
+        if ((n = IR_request(fd, req, 2, reply)) < 3 || reply[1] != index) {
+            printf("No answer from bench.\n");
+            exit(1);
+        }
+        count = reply[2];
+        if (n < 9)
+            break;
+        calls  = reply[3] | reply[4] << 8;
+        states = reply[5] | reply[6] << 8 | (unsigned long)reply[7] << 16 |
+                 (unsigned long)reply[8] << 24;
+        printf("%3d  %-12.*s %6d %10lu %10.1f\n", index, n - 9, &reply[9],
+               calls, states, states / PHI_MHZ);
+    }
+    close(fd);
+
+    exit(0);
+}
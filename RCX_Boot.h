@@ -0,0 +1,117 @@
+/* RCX_Boot.h
+ *
+ * The state of the hardware as the ROM set it up: the RAM interrupt
+ * vectors, the interrupt enables and the timer, serial and A/D
+ * settings that the drivers of the runtime change. boot_save takes a
+ * copy before any driver starts; boot_restore puts it back and so
+ * undoes all drivers at once, whatever their state, before another
+ * program or the same one again is started:
+ *
+ *   struct boot boot;
+ *
+ *   boot_save(&boot);                  first thing in main
+ *   ...
+ *   irq_disable();
+ *   boot_restore(&boot);
+ *
+ * boot_restore is called with interrupts disabled and leaves them so.
+ * Pending interrupt flags are cleared, so that no interrupt of a
+ * driver reaches the ROM's handler after the restore. The motor
+ * register cannot be read; the motors are left floating.
+ */
+
+#ifndef RCX_BOOT_H
+#define RCX_BOOT_H
+
+#include "RCX_H8.h"
+
+#define BOOT_VECTORS  ((0xfdc0 - 0xfd92) / 2)   /* nmi to wovf          */
+
+struct boot { vector vectors[BOOT_VECTORS];
+              word t_ocra, t_ocrb;
+              byte t_ier, t_csr, t_cr, t_ocr;
+              byte t0_cr, t0_csr, t0_cora, t0_corb;
+              byte t1_cr, t1_csr, t1_cora, t1_corb;
+              byte s_cr, ad_csr, stcr, syscr, iscr, ier;
+            };
+
+void boot_save (struct boot *b)
+{
+  byte ccr, i;
+
+  ccr = irq_save();
+  for (i = 0; i < BOOT_VECTORS; i++)
+    b->vectors[i] = (&nmi_vector)[i];
+  b->t_ier = T_IER;
+  b->t_csr = T_CSR;
+  b->t_cr = T_CR;
+  b->t_ocr = T_OCR;
+  T_OCR = b->t_ocr & ~TOCR_OCRS;
+  b->t_ocra = T_OCRA;
+  T_OCR = b->t_ocr | TOCR_OCRS;
+  b->t_ocrb = T_OCRB;
+  T_OCR = b->t_ocr;
+  b->t0_cr = T0_CR;
+  b->t0_csr = T0_CSR;
+  b->t0_cora = T0_CORA;
+  b->t0_corb = T0_CORB;
+  b->t1_cr = T1_CR;
+  b->t1_csr = T1_CSR;
+  b->t1_cora = T1_CORA;
+  b->t1_corb = T1_CORB;
+  b->s_cr = S_CR;
+  b->ad_csr = AD_CSR;
+  b->stcr = STCR;
+  b->syscr = SYSCR;
+  b->iscr = ISCR;
+  b->ier = IER;
+  irq_restore(ccr);
+}
+
+void boot_restore (const struct boot *b)
+{
+  byte i;
+
+  /* Sources off first, then the vectors, then the ROM's settings */
+  T_IER = 0;
+  T0_CR &= ~(TCR8_CMIEA | TCR8_CMIEB);
+  T1_CR &= ~(TCR8_CMIEA | TCR8_CMIEB);
+  S_CR &= ~(SCR_TIE | SCR_RIE | SCR_TEIE);
+  AD_CSR &= ~ADCSR_ADIE;
+  IER = 0;
+
+  /* A flag clears when written 0 after it was read as 1 */
+  T_CSR &= ~(TCSR_OCFA | TCSR_OCFB | TCSR_OVF);
+  T0_CSR &= ~TCSR8_CMFA;
+  T1_CSR &= ~TCSR8_CMFA;
+  AD_CSR &= ~ADCSR_ADF;
+
+  for (i = 0; i < BOOT_VECTORS; i++)
+    (&nmi_vector)[i] = b->vectors[i];
+
+  MOTOR = 0;                            /* write only: all floating     */
+  STCR = b->stcr;
+  SYSCR = b->syscr;
+  ISCR = b->iscr;
+  AD_CSR = b->ad_csr & ~(ADCSR_ADF | ADCSR_ADST);
+  S_CR = b->s_cr;
+  T0_CR = b->t0_cr;
+  T0_CSR = b->t0_csr & ~TCSR8_CMFA;
+  T0_CORA = b->t0_cora;
+  T0_CORB = b->t0_corb;
+  T1_CR = b->t1_cr;
+  T1_CSR = b->t1_csr & ~TCSR8_CMFA;
+  T1_CORA = b->t1_cora;
+  T1_CORB = b->t1_corb;
+  T_CR = b->t_cr;
+  T_OCR = b->t_ocr & ~TOCR_OCRS;
+  T_OCRA = b->t_ocra;
+  T_OCR = b->t_ocr | TOCR_OCRS;
+  T_OCRB = b->t_ocrb;
+  T_OCR = b->t_ocr;
+  T_CSR = b->t_csr & ~(TCSR_OCFA | TCSR_OCFB | TCSR_OVF);
+  T_IER = b->t_ier;
+  IER = b->ier;
+}
+
+#endif /* RCX_BOOT_H */
@@ -3,13 +3,25 @@
  *
  *  Download an S-record program to the RCX and starts it.
  *
+ *  With -p slot, download a program of standard firmware byte codes
+ *  to a program slot (1-5) of the running firmware instead. The
+ *  S-record firmware given after the program is downloaded first.
+ *
+ *  With -s, a firmware image is not downloaded if the host's record
+ *  says that the same image is resident, see firmware_resident. The
+ *  record goes by the versions the brick reports only, so use -s
+ *  only where no other image with the same versions is downloaded.
+ *
+ *  With -v, the image is read back and corrected after the download,
+ *  see verify_firmware.
+ *
  *
  *  Under UNIX systems like IRIX, Linux, and Solaris, this program compiles
  *  with gcc RCX_Download.c -o RCX_Download.
  *
- *  Set DEFAULT_RCX_IR to the name of the RS232 port connected to the 
- *  infrared transmitter/receiver. Set the RCX_IR environment variable 
- *  to override DEFAULT_RCX_IR.
+ *  The RS232 port connected to the infrared transmitter/receiver is
+ *  found as described in RCX_Tower.h. Set the RCX_IR environment
+ *  variable to the name of the port to skip discovery.
  *
  *  Acknowledgements:
  *  
@@ -125,11 +137,7 @@ Send message to RCX and return answer received.
 #include <sys/time.h>
 #include <ctype.h>
 
-#define DEFAULT_RCX_IR   "/dev/term/a"    /* Solaris name of serial port */
-      
-/* Linux - COM1 port is /dev/ttyS0 */
-/* SGI port is          /dev/ttyd2 */
-/* Solaris port is      /dev/term/a */
+#include "RCX_Tower.h"      /* RCX_tower_name, DEFAULT_RCX_IR */
 
 int IR_open()
 {
@@ -137,8 +145,7 @@ int IR_open()
     char * IR_Name;
     struct termios ios;
 
-    if (( IR_Name = getenv("RCX_IR")) == NULL)
-        IR_Name = DEFAULT_RCX_IR;
+    IR_Name = RCX_tower_name();
 
     if ((fd = open(IR_Name, O_RDWR)) < 0) {
 	printf("Open Infraread failed. Name of RCX_IR = %s. \n", IR_Name);
@@ -455,6 +462,104 @@ int unlock_firmware(int fd)
     return a.result;
 }
 
+/* Get ROM and firmware versions. Each version is returned as
+   major << 16 | minor. A firmware version of 0 means that only the
+   ROM is running. Bit 3 of the command byte is toggled between calls,
+   because the RCX ignores a request identical to the previous one. */
+int get_versions(int fd, long * rom, long * firmware)
+{
+    static int toggle = 0;
+    message m;
+    answer  a;
+
+    toggle ^= 0x08;
+    m.bytecount = 6;
+    m.data[0] = 0x15 | toggle;
+    m.data[1] = 1;
+    m.data[2] = 3;
+    m.data[3] = 5;
+    m.data[4] = 7;
+    m.data[5] = 11;
+
+    a = send_receive(fd, m);
+
+    if ((a.result == OK) && (a.bs.bytecount != 9))
+       a.result = BAD_ANSWER;
+
+    if (a.result == OK) {
+       *rom      = ((long)a.bs.data[1] << 24) | ((long)a.bs.data[2] << 16) |
+                   (a.bs.data[3] << 8) | a.bs.data[4];
+       *firmware = ((long)a.bs.data[5] << 24) | ((long)a.bs.data[6] << 16) |
+                   (a.bs.data[7] << 8) | a.bs.data[8];
+    }
+
+    return a.result;
+}
+
+/* Program slot routines for a running standard firmware. */
+
+#define PROGRAM_SLOTS 5
+
+/* Send a request with a one byte answer (the complemented opcode) */
+int send_command(int fd, byte opcode, int argc, byte * argv)
+{
+    message m;
+    answer  a;
+    int i;
+
+    m.data[0] = opcode;
+    for (i = 0; i < argc; i++)
+       m.data[1 + i] = argv[i];
+    m.bytecount = argc + 1;
+
+    a = send_receive(fd, m);
+
+    if ((a.result == OK) && (a.bs.bytecount != 1))
+       a.result = BAD_ANSWER;
+
+    return a.result;
+}
+
+/* Stop all tasks, select a program slot and delete its tasks and
+   subroutines */
+int clear_program(int fd, int slot)
+{
+    byte arg = slot;
+    int result;
+
+    if ((result = send_command(fd, 0x50, 0, NULL)) != OK)
+       return result;
+    if ((result = send_command(fd, 0x91, 1, &arg)) != OK)
+       return result;
+    if ((result = send_command(fd, 0x40, 0, NULL)) != OK)
+       return result;
+    return send_command(fd, 0x70, 0, NULL);
+}
+
+/* Begin download of a task. The blocks that follow are sent by
+   transfer_data like firmware blocks. */
+int start_task_download(int fd, int task, int length)
+{
+    message m;
+    answer  a;
+
+    m.bytecount = 6;
+    m.data[0] = 0x25;
+    m.data[1] = 0;
+    m.data[2] = task;
+    m.data[3] = 0;
+    m.data[4] = (length >> 0) & 0xff;
+    m.data[5] = (length >> 8) & 0xff;
+
+    a = send_receive(fd, m);
+
+    /* Second byte of the answer is 0 if there is room for the task */
+    if ((a.result == OK) && ((a.bs.bytecount != 2) || (a.bs.data[1] != 0)))
+       a.result = BAD_ANSWER;
+
+    return a.result;
+}
+
 char *progname;
 
 
@@ -621,35 +726,29 @@ srec_encode(srec_t *srec, char *line)
 #define STRIP_ZEROS   0
 #endif
 
-int main(int argc, char * argv[])
+/* Read an S-record file into image. Returns the number of bytes to
+   download, sets image_start to the entry point and stripped if
+   trailing zeros are not downloaded. */
+int read_srec(char * filename, byte * image, unsigned short * image_start,
+              int * stripped)
 {
-    unsigned char image[IMAGE_LEN];
     char buf[256];
     FILE *file;
     srec_t srec;
     int line = 0;
-    unsigned short cksum = 0;
-    int addr, index, size, i;
-    int fd;
+    int i;
     int length = 0;
     int strip = STRIP_ZEROS;
-    unsigned short image_start = IMAGE_START;
 
-    progname = argv[0];
-
-    if (argc != 2) {
-	fprintf(stderr, "usage: %s filename\n", argv[0]);
-	exit(1);
-    }
-
-    if ((file = fopen(argv[1], "r")) == NULL) {
-	fprintf(stderr, "%s: failed to open\n", argv[1]);
+    if ((file = fopen(filename, "r")) == NULL) {
+	fprintf(stderr, "%s: failed to open\n", filename);
 	exit(1);
     }
 
     /* Build an image of the srecord data */
 
-    memset(image, 0, sizeof(image));
+    memset(image, 0, IMAGE_LEN);
+    *image_start = IMAGE_START;
 
     while (fgets(buf, sizeof(buf), file)) {
 	int error;
@@ -674,7 +773,7 @@ int main(int argc, char * argv[])
 	    default: errstr = "unknown error"; break;
 	    }
 	    if (errstr) {
-		fprintf(stderr, "%s: %s on line %d\n", argv[1], errstr, line);
+		fprintf(stderr, "%s: %s on line %d\n", filename, errstr, line);
 		exit(1);
 	    }
 	}
@@ -686,7 +785,7 @@ int main(int argc, char * argv[])
 	else if (srec.type == 1) {
 	    if (srec.addr < IMAGE_START || srec.addr + srec.count > IMAGE_END){
 		fprintf(stderr, "%s: address out of bounds on line %d\n",
-			argv[1], line);
+			filename, line);
 		exit(1);
 	    }
 	    if (!strip && (srec.addr + srec.count - IMAGE_START > length))
@@ -696,34 +795,50 @@ int main(int argc, char * argv[])
 	else if (srec.type == 9) {
 	    if (srec.addr < IMAGE_START || srec.addr > IMAGE_END) {
 		fprintf(stderr, "%s: address out of bounds on line %d\n",
-			argv[1], line);
+			filename, line);
 		exit(1);
 	    }
-	    image_start = srec.addr;
+	    *image_start = srec.addr;
 	}
     }
+    fclose(file);
 
     /* Find image length */
 
-
-
     if (strip) {
 	for (length = IMAGE_LEN - 1; length >= 0 && image[length]; length--);
 	length++;
     }
 
     if (length == 0) {
-      fprintf(stderr, "%s: image contains no data\n", argv[1]);
+      fprintf(stderr, "%s: image contains no data\n", filename);
 	exit(1);
     }
 
-    /* Checksum it */
+    *stripped = strip;
+    return length;
+}
+
+/* 16-bit sum of the image bytes, sent with the begin download request */
+unsigned short image_checksum(byte * image, int length)
+{
+    unsigned short cksum = 0;
+    int i;
 
     for (i = 0; i < length; i++)
 	cksum += image[i];
 
-    /* Open the serial port */
-    fd = IR_open();
+    return cksum;
+}
+
+/* Download firmware image through the ROM */
+int download_firmware(int fd, byte * image, int length,
+                      unsigned short image_start)
+{
+    unsigned short cksum;
+
+    /* Checksum it */
+    cksum = image_checksum(image, length);
 
     /* Delete firmware */
     if (delete_firmware(fd) != OK) 
@@ -740,7 +855,514 @@ int main(int argc, char * argv[])
     /* Unlock firmware */
     if (unlock_firmware(fd) != OK) 
 	fprintf(stderr, "%s: RunProgram failed.\n", progname);
+    else
+        return OK;
+
+    return BAD_ANSWER;
+}
+
+/* Number of version requests while a new firmware starts */
+#define FIRMWARE_BOOT_TRIES  10
+
+/* Wait for a newly unlocked firmware to answer. Returns its versions. */
+int wait_for_firmware(int fd, long * rom, long * firmware, int tries)
+{
+    int i;
+
+    *firmware = 0;
+    for (i = 0; i < tries && *firmware == 0; i++)
+	if (get_versions(fd, rom, firmware) != OK)
+	    *firmware = 0;
+
+    return (*firmware != 0) ? OK : BAD_ANSWER;
+}
+
+/* Resident firmware records.
+
+   Neither the ROM nor the standard firmware can report a checksum of
+   the resident image, so the host keeps a record of the image last
+   downloaded for each pair of ROM and firmware versions reported. An
+   image is taken as resident if the brick reports a firmware and the
+   record for its versions has the same checksum, length and start
+   address. The records are kept in the file named by RCX_FIRMWARE_DB,
+   default $HOME/.rcx_firmware, one line per record:
+
+     rom firmware checksum length start
+
+   Only downloads with -s are recorded, and the record cannot tell
+   bricks apart: after a download of an image to one brick, another
+   brick whose image reports the same versions is taken to hold it as
+   well. -s is for bricks that are loaded with nothing else.
+*/
+
+#define FIRMWARE_DB_FILE  ".rcx_firmware"
+#define FIRMWARE_DB_MAX   64
+
+struct firmware_record_t { long rom, firmware;
+                           unsigned int cksum, length, start;
+                         };
+typedef struct firmware_record_t firmware_record;
+
+char * firmware_db_name(char * name, int size)
+{
+    char *s;
+
+    if ((s = getenv("RCX_FIRMWARE_DB")) != NULL)
+	snprintf(name, size, "%s", s);
+    else if ((s = getenv("HOME")) != NULL)
+	snprintf(name, size, "%s/%s", s, FIRMWARE_DB_FILE);
+    else
+	return NULL;
+    return name;
+}
+
+int firmware_db_read(firmware_record * db)
+{
+    char name[256];
+    FILE *file;
+    int n = 0;
+
+    if (firmware_db_name(name, sizeof(name)) == NULL ||
+	(file = fopen(name, "r")) == NULL)
+	return 0;
+    while (n < FIRMWARE_DB_MAX &&
+	   fscanf(file, "%lx %lx %x %x %x", &db[n].rom, &db[n].firmware,
+		  &db[n].cksum, &db[n].length, &db[n].start) == 5)
+	n++;
+    fclose(file);
+
+    return n;
+}
+
+/* Is the image resident on a brick reporting these versions? */
+int firmware_resident(long rom, long firmware, byte * image, int length,
+                      unsigned short image_start)
+{
+    firmware_record db[FIRMWARE_DB_MAX];
+    int n, i;
+
+    if (firmware == 0)
+	return 0;
+
+    n = firmware_db_read(db);
+    for (i = 0; i < n; i++)
+	if (db[i].rom == rom && db[i].firmware == firmware)
+	    return db[i].cksum  == image_checksum(image, length) &&
+		   db[i].length == length &&
+		   db[i].start  == image_start;
+    return 0;
+}
+
+/* Record the image downloaded to a brick reporting these versions */
+void firmware_db_write(long rom, long firmware, byte * image, int length,
+                       unsigned short image_start)
+{
+    firmware_record db[FIRMWARE_DB_MAX];
+    char name[256];
+    FILE *file;
+    int n, i;
+
+    n = firmware_db_read(db);
+    for (i = 0; i < n; i++)
+	if (db[i].rom == rom && db[i].firmware == firmware)
+	    break;
+    if (i == FIRMWARE_DB_MAX)
+	i = FIRMWARE_DB_MAX - 1;
+    if (i == n && n < FIRMWARE_DB_MAX)
+	n++;
+
+    db[i].rom      = rom;
+    db[i].firmware = firmware;
+    db[i].cksum    = image_checksum(image, length);
+    db[i].length   = length;
+    db[i].start    = image_start;
+
+    if (firmware_db_name(name, sizeof(name)) == NULL ||
+	(file = fopen(name, "w")) == NULL)
+	return;
+    for (i = 0; i < n; i++)
+	fprintf(file, "%lx %lx %04x %04x %04x\n", db[i].rom, db[i].firmware,
+		db[i].cksum, db[i].length, db[i].start);
+    fclose(file);
+}
+
+/* Verification by read-back.
+
+   The helper in verify.s is appended behind the image and downloaded
+   with it; the ROM starts the helper instead of the image. The host
+   asks the helper for a CRC-16 of each TRANSFER_SIZE block of the
+   image, re-sends the blocks that differ from the host image, and
+   finally lets the helper jump to the image's entry point. Only two
+   bytes per block are uploaded, so a verify takes a small part of the
+   time of a download.
+
+   The helper is read from the S-record file named by RCX_VERIFY,
+   default verify.srec, built with make verify.srec. Until the image
+   is started, the helper occupies the memory behind the image, so
+   images that rely on zeros there (stripped images) cannot be
+   verified.
+*/
+
+#define VERIFY_HELPER  "verify.srec"
+#define VERIFY_CRC     0x26
+#define VERIFY_WRITE   0x36
+#define VERIFY_RUN     0x46
+#define VERIFY_PASSES  3     /* re-send rounds before giving up        */
+#define HELPER_TRIES   10    /* alive requests while the helper starts */
+#define VERIFY_BLOCKS  ((IMAGE_LEN + TRANSFER_SIZE - 1) / TRANSFER_SIZE)
+
+/* CRC-16-CCITT, polynomial 0x1021, initial value 0xffff, as crc16 in
+   verify.s */
+unsigned short crc16(byte * data, int length)
+{
+    unsigned short crc = 0xffff;
+    int i, j;
+
+    for (i = 0; i < length; i++) {
+	crc ^= data[i] << 8;
+	for (j = 0; j < 8; j++)
+	    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+/* Send a helper request with an address and two parameter bytes.
+   data, if not NULL, is sent after the parameters. */
+answer helper_request(int fd, byte opcode, int addr, int p1, int p2,
+                      byte * data, int length)
+{
+    message m;
+
+    m.data[0] = opcode;
+    m.data[1] = (addr >> 0) & 0xff;
+    m.data[2] = (addr >> 8) & 0xff;
+    m.data[3] = p1;
+    m.data[4] = p2;
+    if (data != NULL)
+	memcpy(&m.data[5], data, length);
+    m.bytecount = 5 + length;
+
+    return send_receive(fd, m);
+}
 
+/* Wait for the helper to answer an alive request */
+int helper_alive(int fd)
+{
+    message m;
+    answer  a;
+    int i;
+
+    a.result = NO_ECHO;
+    for (i = 0; i < HELPER_TRIES && a.result != OK; i++) {
+	m.bytecount = 1;
+	m.data[0] = 0x10 | ((i & 1) << 3);
+	a = send_receive(fd, m);
+	if ((a.result == OK) && (a.bs.bytecount != 1))
+	    a.result = BAD_ANSWER;
+    }
+    return a.result;
+}
+
+/* Get the CRCs of count blocks of size bytes from addr */
+int helper_crc(int fd, int addr, int size, int count, unsigned short * crc)
+{
+    answer a;
+    int i;
+
+    a = helper_request(fd, VERIFY_CRC, addr, size, count, NULL, 0);
+
+    if ((a.result == OK) && (a.bs.bytecount != 1 + 2 * count))
+	a.result = BAD_ANSWER;
+
+    if (a.result == OK)
+	for (i = 0; i < count; i++)
+	    crc[i] = a.bs.data[1 + 2*i] | (a.bs.data[2 + 2*i] << 8);
+
+    return a.result;
+}
+
+/* Get the CRCs of all TRANSFER_SIZE blocks of an image of length bytes */
+int image_crc(int fd, int length, unsigned short * crc)
+{
+    int full = length / TRANSFER_SIZE;
+    int result = OK;
+
+    if (full > 0)
+	result = helper_crc(fd, IMAGE_START, TRANSFER_SIZE, full, crc);
+    if (result == OK && length % TRANSFER_SIZE)
+	result = helper_crc(fd, IMAGE_START + full * TRANSFER_SIZE,
+			    length % TRANSFER_SIZE, 1, &crc[full]);
+    return result;
+}
+
+int helper_write(int fd, int addr, byte * data, int length)
+{
+    answer a;
+
+    a = helper_request(fd, VERIFY_WRITE, addr, length, 0, data, length);
+
+    if ((a.result == OK) && (a.bs.bytecount != 1))
+	a.result = BAD_ANSWER;
+
+    return a.result;
+}
+
+int helper_run(int fd, int addr)
+{
+    answer a;
+
+    a = helper_request(fd, VERIFY_RUN, addr, 0, 0, NULL, 0);
+
+    if ((a.result == OK) && (a.bs.bytecount != 1))
+	a.result = BAD_ANSWER;
+
+    return a.result;
+}
+
+/* Download image with the helper, verify it, and start it */
+int verify_firmware(int fd, byte * image, int length,
+                    unsigned short image_start, int stripped)
+{
+    byte helper[IMAGE_LEN];
+    byte both[IMAGE_LEN];
+    unsigned short crc[VERIFY_BLOCKS];
+    unsigned short helper_start;
+    char *helper_name;
+    int helper_length, helper_stripped, offset;
+    int blocks, bad, resent, pass, i, size;
+
+    if (stripped) {
+	fprintf(stderr, "%s: a stripped image cannot be verified.\n",
+		progname);
+	return BAD_ANSWER;
+    }
+
+    if ((helper_name = getenv("RCX_VERIFY")) == NULL)
+	helper_name = VERIFY_HELPER;
+    helper_length = read_srec(helper_name, helper, &helper_start,
+			      &helper_stripped);
+
+    /* The helper starts on the first word boundary behind the image */
+    offset = (length + 1) & ~1;
+    if (offset + helper_length > IMAGE_LEN) {
+	fprintf(stderr, "%s: no room for the verify helper.\n", progname);
+	return BAD_ANSWER;
+    }
+    memcpy(both, image, IMAGE_LEN);
+    memcpy(&both[offset], helper, helper_length);
+
+    /* The helper is linked at IMAGE_START and is position independent */
+    if (download_firmware(fd, both, offset + helper_length,
+			  helper_start + offset) != OK)
+	return BAD_ANSWER;
+
+    if (helper_alive(fd) != OK) {
+	fprintf(stderr, "%s: verify helper does not answer.\n", progname);
+	return BAD_ANSWER;
+    }
+
+    blocks = (length + TRANSFER_SIZE - 1) / TRANSFER_SIZE;
+    resent = 0;
+    pass = 0;
+    do {
+	if (image_crc(fd, length, crc) != OK) {
+	    fprintf(stderr, "%s: BlockCrc failed.\n", progname);
+	    return BAD_ANSWER;
+	}
+	bad = 0;
+	for (i = 0; i < blocks; i++) {
+	    size = length - i * TRANSFER_SIZE;
+	    if (size > TRANSFER_SIZE)
+		size = TRANSFER_SIZE;
+	    if (crc[i] == crc16(&image[i * TRANSFER_SIZE], size))
+		continue;
+	    bad++;
+	    if (pass == VERIFY_PASSES)
+		continue;
+	    if (helper_write(fd, IMAGE_START + i * TRANSFER_SIZE,
+			     &image[i * TRANSFER_SIZE], size) != OK) {
+		fprintf(stderr, "%s: WriteBlock failed.\n", progname);
+		return BAD_ANSWER;
+	    }
+	    resent++;
+	}
+    } while (bad > 0 && pass++ < VERIFY_PASSES);
+
+    if (bad > 0) {
+	fprintf(stderr, "%s: %d of %d blocks differ after %d re-sends.\n",
+		progname, bad, blocks, resent);
+	return BAD_ANSWER;
+    }
+
+    if (helper_run(fd, image_start) != OK) {
+	fprintf(stderr, "%s: RunProgram failed.\n", progname);
+	return BAD_ANSWER;
+    }
+
+    printf("Verified %d blocks, %d re-sent.\n", blocks, resent);
+    return OK;
+}
+
+/* Download firmware. With skip, not if the same image is resident,
+   and when a download succeeds, record the new firmware. */
+int update_firmware(int fd, byte * image, int length,
+                    unsigned short image_start, int stripped,
+                    int skip, int verify)
+{
+    long rom = 0, firmware = 0;
+
+    if (skip && get_versions(fd, &rom, &firmware) == OK &&
+	firmware_resident(rom, firmware, image, length, image_start)) {
+	printf("Firmware %lx.%04lx with checksum %04x resident, "
+	       "not downloaded.\n", firmware >> 16, firmware & 0xffff,
+	       image_checksum(image, length));
+	return OK;
+    }
+
+    if (verify) {
+	if (verify_firmware(fd, image, length, image_start, stripped) != OK)
+	    return BAD_ANSWER;
+    }
+    else
+    if (download_firmware(fd, image, length, image_start) != OK)
+	return BAD_ANSWER;
+
+    /* Only a firmware that is up at once is recorded; images that do
+       not answer requests must not delay the download */
+    if (skip && wait_for_firmware(fd, &rom, &firmware, 1) == OK)
+	firmware_db_write(rom, firmware, image, length, image_start);
+
+    return OK;
+}
+
+/* Read a program file of standard firmware byte codes into program. 
+   The whole file is the body of task 0. */
+int read_program(char * filename, byte * program)
+{
+    FILE *file;
+    int length;
+
+    if ((file = fopen(filename, "rb")) == NULL) {
+	fprintf(stderr, "%s: failed to open\n", filename);
+	exit(1);
+    }
+    length = fread(program, 1, IMAGE_LEN, file);
+    if (!feof(file)) {
+	fprintf(stderr, "%s: program too large\n", filename);
+	exit(1);
+    }
+    fclose(file);
+
+    if (length == 0) {
+	fprintf(stderr, "%s: program contains no data\n", filename);
+	exit(1);
+    }
+
+    return length;
+}
+
+/* Download a program to a slot of the running firmware */
+int download_program(int fd, int slot, byte * program, int length)
+{
+    /* Select slot and clear it */
+    if (clear_program(fd, slot) != OK)
+	fprintf(stderr, "%s: SelectProgram failed.\n", progname);
+    else
+    /* Start task download */
+    if (start_task_download(fd, 0, length) != OK)
+	fprintf(stderr, "%s: BeginTask failed.\n", progname);
+    else
+    /* Transfer data */
+    if (transfer_data(fd, program, length) != OK)
+        fprintf(stderr, "%s: DownloadBlock failed.\n", progname);
+    else
+        return OK;
+
+    return BAD_ANSWER;
+}
+
+int usage(void)
+{
+    fprintf(stderr, "usage: %s [-s] [-v] filename\n", progname);
+    fprintf(stderr, "       %s [-s] -p slot program [firmware]\n", progname);
+    exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+    unsigned char image[IMAGE_LEN];
+    unsigned char program[IMAGE_LEN];
+    int fd, arg;
+    int length = 0;
+    int program_length = 0;
+    int slot = -1;
+    int skip = 0;
+    int verify = 0;
+    int stripped = 0;
+    long rom = 0, firmware = 0;
+    char *firmware_name = NULL;
+    unsigned short image_start = IMAGE_START;
+
+    progname = argv[0];
+
+    for (arg = 1; arg < argc; arg++)
+	if (!strcmp(argv[arg], "-s"))
+	    skip = 1;
+	else if (!strcmp(argv[arg], "-v"))
+	    verify = 1;
+	else
+	    break;
+    if (argc - arg == 1 && argv[arg][0] != '-')
+	firmware_name = argv[arg];
+    else if ((argc - arg == 3 || argc - arg == 4) && 
+	     !strcmp(argv[arg], "-p")) {
+	slot = atoi(argv[arg+1]) - 1;
+	if (slot < 0 || slot >= PROGRAM_SLOTS) {
+	    fprintf(stderr, "%s: slot must be 1 to %d\n", progname,
+		    PROGRAM_SLOTS);
+	    exit(1);
+	}
+	program_length = read_program(argv[arg+2], program);
+	if (argc - arg == 4)
+	    firmware_name = argv[arg+3];
+	if (verify)
+	    usage();
+    }
+    else
+	usage();
+
+    if (firmware_name != NULL)
+	length = read_srec(firmware_name, image, &image_start, &stripped);
+
+    /* Open the serial port */
+    fd = IR_open();
+
+    if (slot < 0) {
+	update_firmware(fd, image, length, image_start, stripped,
+			skip, verify);
+	IR_close(fd);
+	exit(0);
+    }
+
+    /* Program download: with -s, the firmware step is skipped if the
+       image is resident */
+    if (firmware_name != NULL &&
+	update_firmware(fd, image, length, image_start, stripped,
+			skip, 0) != OK) {
+	IR_close(fd);
+	exit(1);
+    }
+
+    if (wait_for_firmware(fd, &rom, &firmware, FIRMWARE_BOOT_TRIES) != OK) {
+	fprintf(stderr, "%s: no firmware resident.\n", progname);
+	IR_close(fd);
+	exit(1);
+    }
+
+    if (download_program(fd, slot, program, program_length) != OK) {
+	IR_close(fd);
+	exit(1);
+    }
 
     IR_close(fd);
 
@@ -0,0 +1,356 @@
+/* RCX_Event.h
+ *
+ * Events from the buttons, timers and sensors, queued and handed to
+ * handlers by a task of RCX_Sched.h.
+ *
+ *   void run_pressed (byte arg)
+ *   { if (arg == (BUTTON_RUN | BUTTON_PRESSED)) ... }
+ *
+ *   sched_init();
+ *   event_init();
+ *   event_on(EVENT_BUTTON, run_pressed);
+ *   sched_run();
+ *
+ * Buttons are sampled every EVENT_POLL_MS and at once when the run or
+ * on/off button interrupts. A change is reported immediately if the
+ * button had been stable for EVENT_DEBOUNCE_MS; bounces within that
+ * time after a change are ignored. The on/off button no longer
+ * switches the RCX off while events are on.
+ *
+ * Cost, in states of the H8/300 at 16 MHz, 16 states per us:
+ *
+ *   interrupt accepted, ROM dispatch through the RAM vector  48
+ *   event_irq_handler, run and on/off buttons                84
+ *   RCX_HANDLER around a C function, besides the function    56
+ *   event_post                                              ~200
+ *   event task, per event handed to a handler               ~400
+ *
+ * The button interrupt saves no register: it only uses r6, which the
+ * ROM saved. The latency from an interrupt or event_post to the call
+ * of the handler is measured for each event type in event_stat, in us.
+ * It is the time the scheduler needs to get to the event task, at most
+ * the longest run of any other task.
+ */
+
+#ifndef RCX_EVENT_H
+#define RCX_EVENT_H
+
+#include "RCX_Sensor.h"
+
+#define EVENT_BUTTON      0             /* arg: button | BUTTON_PRESSED */
+#define EVENT_TIMER       1             /* arg: timer number            */
+#define EVENT_SENSOR      2             /* arg: sensor | SENSOR_ABOVE   */
+#define EVENT_USER        3             /* arg: any, from event_post    */
+#define EVENT_TYPES       4
+
+#define EVENT_QUEUE       16            /* power of 2                   */
+#define EVENT_TIMERS      4
+#define EVENT_POLL_MS     2
+#define EVENT_DEBOUNCE_MS 20
+
+/* Buttons, the bits of RCX_H8.h */
+#define BUTTON_PRESSED    0x01
+
+/* Sensors 0-2 are the inputs labelled 1-3 */
+#define SENSOR_ABOVE      0x80
+
+/* ms and frc stamp when the event happened, for event_stat */
+struct event { byte type;
+               byte arg;
+               uint16 ms;
+               uint16 frc;
+             };
+
+struct event_stat { uint16 count;
+                    uint16 last_us;
+                    uint16 max_us;
+                  };
+
+struct event_timer { uint16 period;
+                     uint16 due;
+                   };
+
+/* A sensor event is sent when the value rises above high or falls
+ * below low. low < high gives hysteresis against noise.
+ */
+struct event_sensor { uint16 low;
+                      uint16 high;
+                      byte on;
+                      byte above;
+                    };
+
+struct event event_queue[EVENT_QUEUE];
+volatile byte event_head, event_tail;
+volatile byte event_lost;
+
+void (*event_handler[EVENT_TYPES])(byte arg);
+struct event_stat event_stat[EVENT_TYPES];
+struct event_timer event_timers[EVENT_TIMERS];
+struct event_sensor event_sensors[3];
+
+byte event_buttons;                     /* debounced state              */
+uint16 event_buttons_ms;                /* time of the last change      */
+
+task_id event_task;
+volatile byte *event_wake;              /* &sched_task[event_task].ready */
+volatile byte event_edge;               /* set by event_irq_handler     */
+volatile uint16 event_edge_ms, event_edge_frc;
+vector event_old_irq0, event_old_irq1;
+
+/* Run and on/off button interrupt: note the time and wake the event
+ * task. r6 is saved by the ROM. If compare match A is pending, the FRC
+ * has been cleared but time_msec not counted yet.
+ */
+void event_irq_handler (void);
+asm (".section .text\n\t"
+     ".align 1\n"
+     "_event_irq_handler:\n\t"
+     "mov.w @0xff92:16,r6     ; FRC\n\t"
+     "btst #3,@0xff91:8       ; OCFA\n\t"
+     "bne 1f\n\t"
+     "mov.w r6,@_event_edge_frc\n\t"
+     "mov.w @_time_msec+2,r6\n\t"
+     "bra 2f\n"
+     "1:\n\t"
+     "mov.w @0xff92:16,r6\n\t"
+     "mov.w r6,@_event_edge_frc\n\t"
+     "mov.w @_time_msec+2,r6\n\t"
+     "adds #1,r6\n"
+     "2:\n\t"
+     "mov.w r6,@_event_edge_ms\n\t"
+     "mov.w #_event_edge,r6\n\t"
+     "bset #0,@r6\n\t"
+     "mov.w @_event_wake,r6\n\t"
+     "bset #0,@r6             ; ready\n\t"
+     "mov.w #_sched_pending,r6\n\t"
+     "bset #0,@r6\n\t"
+     "rts");
+
+/* Current time as ms and FRC count */
+void event_now (uint16 *ms, uint16 *frc)
+{
+  byte ccr;
+
+  ccr = irq_save();
+  *frc = T_CNT;
+  *ms = time_ticks();
+  if (T_CSR & TCSR_OCFA) {
+    *frc = T_CNT;
+    (*ms)++;
+  }
+  irq_restore(ccr);
+}
+
+/* Queue an event that happened at ms, frc */
+byte event_post_at (byte type, byte arg, uint16 ms, uint16 frc)
+{
+  struct event *e;
+  byte ccr, head, next;
+
+  ccr = irq_save();
+  head = event_head;
+  next = (head + 1) & (EVENT_QUEUE - 1);
+  if (next == event_tail) {
+    event_lost++;
+    irq_restore(ccr);
+    return 0;
+  }
+  e = &event_queue[head];
+  e->type = type;
+  e->arg = arg;
+  e->ms = ms;
+  e->frc = frc;
+  event_head = next;
+  irq_restore(ccr);
+
+  task_wake(event_task);
+  return 1;
+}
+
+/* Queue an event. May be called from interrupt handlers. Returns 0 if
+ * the queue is full.
+ */
+byte event_post (byte type, byte arg)
+{
+  uint16 ms, frc;
+
+  event_now(&ms, &frc);
+  return event_post_at(type, arg, ms, frc);
+}
+
+/* Call handler for events of type. 0 ignores them. */
+void event_on (byte type, void (*handler)(byte arg))
+{
+  event_handler[type] = handler;
+}
+
+/* Send EVENT_TIMER n every ms milliseconds; 0 stops it */
+void event_timer (byte n, uint16 ms)
+{
+  event_timers[n].period = ms;
+  event_timers[n].due = time_ticks() + ms;
+}
+
+/* Send EVENT_SENSOR for sensor n when its value, 0-1023, rises above
+ * high or falls below low. The value is read with the filter of the
+ * sensor; sensors not on yet are turned on unfiltered.
+ */
+void event_sensor (byte n, uint16 low, uint16 high)
+{
+  struct event_sensor *s = &event_sensors[n];
+
+  s->low = low;
+  s->high = high;
+  s->above = 0;
+  s->on = 1;
+
+  if (!sensor[n].on)
+    sensor_on(n, SENSOR_RAW);
+}
+
+/* A change is stamped with the time of the button interrupt, if the
+ * run or on/off button interrupted since the last change. An edge
+ * without a change is dropped once it is older than the debounce.
+ */
+void event_poll_buttons (uint16 now)
+{
+  uint16 ms, frc;
+  byte state, changed, bit;
+
+  state = button_state();
+  changed = state ^ event_buttons;
+  if (changed == 0) {
+    if ((uint16)(now - event_edge_ms) >= EVENT_DEBOUNCE_MS)
+      event_edge = 0;
+    return;
+  }
+  if ((uint16)(now - event_buttons_ms) < EVENT_DEBOUNCE_MS)
+    return;
+
+  event_buttons = state;
+  event_buttons_ms = now;
+  if (event_edge) {
+    ms = event_edge_ms;
+    frc = event_edge_frc;
+    event_edge = 0;
+  } else
+    event_now(&ms, &frc);
+  for (bit = BUTTON_ONOFF; bit != 0; bit <<= 1)
+    if (changed & bit)
+      event_post_at(EVENT_BUTTON, bit | (state & bit ? BUTTON_PRESSED : 0),
+                    ms, frc);
+}
+
+void event_poll_timers (uint16 now)
+{
+  struct event_timer *t;
+  byte n;
+
+  for (n = 0, t = event_timers; n < EVENT_TIMERS; n++, t++)
+    if (t->period && (int16)(now - t->due) >= 0) {
+      event_post_at(EVENT_TIMER, n, t->due, 0);
+      do
+        t->due += t->period;
+      while ((int16)(now - t->due) >= 0);
+    }
+}
+
+void event_poll_sensors (void)
+{
+  struct event_sensor *s;
+  uint16 value;
+  byte n;
+
+  for (n = 0, s = event_sensors; n < 3; n++, s++) {
+    if (!s->on)
+      continue;
+    value = sensor_read(n);
+    if (!s->above && value > s->high) {
+      s->above = 1;
+      event_post(EVENT_SENSOR, n | SENSOR_ABOVE);
+    } else if (s->above && value < s->low) {
+      s->above = 0;
+      event_post(EVENT_SENSOR, n);
+    }
+  }
+}
+
+/* Latency from the stamp of e to now, in us, at most 65535 */
+uint16 event_latency (struct event *e)
+{
+  uint16 ms, frc;
+  uint32 us;
+
+  event_now(&ms, &frc);
+  us = (uint32)(uint16)(ms - e->ms) * 1000 + frc * TIME_US_PER_FRC -
+       e->frc * TIME_US_PER_FRC;
+  return us > 0xffff ? 0xffff : us;
+}
+
+/* The event task: poll, then hand the queued events to the handlers */
+void event_run (void)
+{
+  struct event e;
+  struct event_stat *st;
+  uint16 now;
+  byte tail;
+
+  now = time_ticks();
+  event_poll_buttons(now);
+  event_poll_timers(now);
+  event_poll_sensors();
+
+  while ((tail = event_tail) != event_head) {
+    e = event_queue[tail];
+    event_tail = (tail + 1) & (EVENT_QUEUE - 1);
+
+    st = &event_stat[e.type];
+    st->count++;
+    st->last_us = event_latency(&e);
+    if (st->last_us > st->max_us)
+      st->max_us = st->last_us;
+
+    if (event_handler[e.type])
+      event_handler[e.type](e.arg);
+  }
+}
+
+/* Start the event task and take the run and on/off button interrupts
+ * over from the ROM. Needs sched_init first.
+ */
+void event_init (void)
+{
+  byte ccr;
+
+  event_task = task_create(event_run);
+  event_wake = &sched_task[event_task].ready;
+  task_every(event_task, EVENT_POLL_MS);
+
+  event_head = event_tail = 0;
+  event_buttons = button_state();
+  event_buttons_ms = time_ticks();
+  event_edge = 0;
+
+  ccr = irq_save();
+  event_old_irq0 = irq0_vector;
+  event_old_irq1 = irq1_vector;
+  irq0_vector = event_irq_handler;
+  irq1_vector = event_irq_handler;
+  ISCR |= 0x03;                         /* falling edges                */
+  IER |= 0x03;
+  irq_restore(ccr);
+}
+
+/* Give the buttons back to the ROM */
+void event_shutdown (void)
+{
+  byte ccr;
+
+  ccr = irq_save();
+  irq0_vector = event_old_irq0;
+  irq1_vector = event_old_irq1;
+  irq_restore(ccr);
+  task_every(event_task, 0);
+}
+
+#endif /* RCX_EVENT_H */
@@ -0,0 +1,341 @@
+/* RCX_Fixed.h
+ *
+ * Fixed point arithmetic. q8_8 is a 16 bit value with 8 fraction
+ * bits, q16_16 a 32 bit value with 16. Results that do not fit are
+ * saturated to the largest or smallest value instead of wrapping, so
+ * a control loop that overshoots does not turn around.
+ *
+ * The H8/300 multiplies and divides only bytes, with mulxu (8 x 8 =
+ * 16 bits) and divxu (16 / 8 = 8 bits quotient and remainder), in 14
+ * states each. umul16 builds 16 x 16 = 32 bits from four mulxu.
+ * udiv32_8 divides by a byte with four divxu. Larger divisors are
+ * divided a bit at a time.
+ *
+ * Approximate cost in states, 16 per us:
+ *
+ *   umul16                 ~110     __mulsi3 of libgcc  ~600
+ *   q8_mul                 ~150
+ *   q16_mul                ~500
+ *   udiv32_8               ~100     __udivsi3           ~1500
+ *   q8_div, |b| < 1.0      ~170
+ *   q8_div, |b| >= 1.0     ~1100
+ *   q16_div                ~2000
+ *   q8_add_sat, q8_sub_sat   ~20
+ *   q8_sin, q8_cos           ~40
+ *   q8_sqrt                 ~600
+ *   bcd4                    ~100
+ *
+ * Angles are bytes, 256 to the full circle, so they wrap by
+ * themselves.
+ */
+
+#ifndef RCX_FIXED_H
+#define RCX_FIXED_H
+
+#include "RCX_RTE.h"
+
+typedef int16 q8_8;
+typedef int32 q16_16;
+
+#define Q8_ONE          ((q8_8)0x0100)
+#define Q8_MAX          ((q8_8)0x7fff)
+#define Q8_MIN          ((q8_8)-0x8000)
+#define Q16_ONE         ((q16_16)0x00010000L)
+#define Q16_MAX         ((q16_16)0x7fffffffL)
+#define Q16_MIN         ((q16_16)(-0x7fffffffL - 1))
+
+/* Conversions. Constants fold at compile time. */
+#define Q8(x)           ((q8_8)((x) * 256.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define Q16(x)          ((q16_16)((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define q8_from_int(i)  ((q8_8)((i) << 8))
+#define q8_to_int(q)    ((int16)((q) + 0x80) >> 8)
+#define q16_from_q8(q)  ((q16_16)(q) << 8)
+#define q16_to_int(q)   ((int16)(((q) + 0x8000L) >> 16))
+
+/* Unsigned a * b, 8 x 8 = 16 bits */
+static inline uint16 mulxu (byte a, byte b)
+{
+  register uint16 d asm ("r0") = a;
+  register uint16 s asm ("r1") = b;
+
+  asm ("mulxu r1l,r0" : "+r" (d) : "r" (s));
+  return d;
+}
+
+/* Unsigned n / d, quotient in the low byte, remainder in the high
+ * byte. The quotient must fit in a byte.
+ */
+static inline uint16 divxu (uint16 n, byte d)
+{
+  register uint16 r asm ("r0") = n;
+  register uint16 s asm ("r1") = d;
+
+  asm ("divxu r1l,r0" : "+r" (r) : "r" (s));
+  return r;
+}
+
+/* Unsigned a * b, 16 x 16 = 32 bits */
+uint32 umul16 (uint16 a, uint16 b)
+{
+  byte al = a, ah = a >> 8, bl = b, bh = b >> 8;
+  uint32 mid;
+
+  mid = (uint32)mulxu(ah, bl) + mulxu(al, bh);
+  return ((uint32)mulxu(ah, bh) << 16 | mulxu(al, bl)) + (mid << 8);
+}
+
+/* Unsigned n / d for a byte d, remainder in *rem if rem is not 0 */
+uint32 udiv32_8 (uint32 n, byte d, byte *rem)
+{
+  uint16 r;
+  uint32 q;
+
+  r = divxu(n >> 24, d);
+  q = (uint32)(byte)r << 24;
+  r = divxu((r & 0xff00) | (byte)(n >> 16), d);
+  q |= (uint32)(byte)r << 16;
+  r = divxu((r & 0xff00) | (byte)(n >> 8), d);
+  q |= (uint16)(byte)r << 8;
+  r = divxu((r & 0xff00) | (byte)n, d);
+  q |= (byte)r;
+
+  if (rem)
+    *rem = r >> 8;
+  return q;
+}
+
+/* Unsigned n / d a bit at a time, for d of more than a byte */
+uint32 udiv32_16 (uint32 n, uint16 d)
+{
+  uint32 r;
+  byte i;
+
+  r = 0;
+  for (i = 0; i < 32; i++) {
+    r = (r << 1) | (n >> 31);
+    n <<= 1;
+    if (r >= d) {
+      r -= d;
+      n |= 1;
+    }
+  }
+  return n;
+}
+
+/* Saturate to q8_8 */
+static inline q8_8 q8_sat (int32 x)
+{
+  if (x > Q8_MAX)
+    return Q8_MAX;
+  if (x < Q8_MIN)
+    return Q8_MIN;
+  return x;
+}
+
+static inline q8_8 q8_add_sat (q8_8 a, q8_8 b)
+{
+  q8_8 s = (uint16)a + (uint16)b;
+
+  /* overflow if a and b have the same sign and s the other */
+  if (((a ^ s) & (b ^ s)) < 0)
+    return a < 0 ? Q8_MIN : Q8_MAX;
+  return s;
+}
+
+static inline q8_8 q8_sub_sat (q8_8 a, q8_8 b)
+{
+  q8_8 s = (uint16)a - (uint16)b;
+
+  if (((a ^ b) & (a ^ s)) < 0)
+    return a < 0 ? Q8_MIN : Q8_MAX;
+  return s;
+}
+
+static inline q16_16 q16_add_sat (q16_16 a, q16_16 b)
+{
+  q16_16 s = (uint32)a + (uint32)b;
+
+  if (((a ^ s) & (b ^ s)) < 0)
+    return a < 0 ? Q16_MIN : Q16_MAX;
+  return s;
+}
+
+static inline q16_16 q16_sub_sat (q16_16 a, q16_16 b)
+{
+  q16_16 s = (uint32)a - (uint32)b;
+
+  if (((a ^ b) & (a ^ s)) < 0)
+    return a < 0 ? Q16_MIN : Q16_MAX;
+  return s;
+}
+
+/* a * b, rounded */
+q8_8 q8_mul (q8_8 a, q8_8 b)
+{
+  uint32 p;
+  byte neg;
+
+  neg = (a ^ b) < 0;
+  p = (umul16(a < 0 ? -a : a, b < 0 ? -b : b) + 0x80) >> 8;
+
+  if (neg)
+    return p > 0x8000 ? Q8_MIN : -(int32)p;
+  return p > 0x7fff ? Q8_MAX : p;
+}
+
+/* a / b, truncated. Division by 0 saturates. */
+q8_8 q8_div (q8_8 a, q8_8 b)
+{
+  uint16 ua, ub;
+  uint32 q;
+  byte neg;
+
+  neg = (a ^ b) < 0;
+  ua = a < 0 ? -a : a;
+  ub = b < 0 ? -b : b;
+
+  if (ub == 0)
+    q = 0xffffffffUL;
+  else if (ub < 0x100)
+    q = udiv32_8((uint32)ua << 8, ub, 0);
+  else
+    q = udiv32_16((uint32)ua << 8, ub);
+
+  if (neg)
+    return q > 0x8000 ? Q8_MIN : -(int32)q;
+  return q > 0x7fff ? Q8_MAX : q;
+}
+
+/* a * b, truncated */
+q16_16 q16_mul (q16_16 a, q16_16 b)
+{
+  uint32 ua, ub, hi, p, sum;
+  uint16 ah, al, bh, bl;
+  byte neg;
+
+  neg = (a ^ b) < 0;
+  ua = a < 0 ? -(uint32)a : a;
+  ub = b < 0 ? -(uint32)b : b;
+  ah = ua >> 16; al = ua;
+  bh = ub >> 16; bl = ub;
+
+  hi = umul16(ah, bh);
+  if (hi > 0x7fff)
+    return neg ? Q16_MIN : Q16_MAX;
+
+  sum = hi << 16;
+  p = umul16(ah, bl);
+  if ((sum += p) < p)
+    return neg ? Q16_MIN : Q16_MAX;
+  p = umul16(al, bh);
+  if ((sum += p) < p)
+    return neg ? Q16_MIN : Q16_MAX;
+  p = umul16(al, bl) >> 16;
+  if ((sum += p) < p)
+    return neg ? Q16_MIN : Q16_MAX;
+
+  if (neg)
+    return sum > 0x80000000UL ? Q16_MIN : -(int32)sum;
+  return sum > 0x7fffffffUL ? Q16_MAX : (int32)sum;
+}
+
+/* a / b, truncated. The 48 bit dividend is divided a bit at a time.
+ * Division by 0 saturates.
+ */
+q16_16 q16_div (q16_16 a, q16_16 b)
+{
+  uint32 ua, ub, r, q;
+  byte i, neg, over;
+
+  neg = (a ^ b) < 0;
+  ua = a < 0 ? -(uint32)a : a;
+  ub = b < 0 ? -(uint32)b : b;
+
+  if (ub == 0 || (ua >> 16) >= ub)
+    return neg ? Q16_MIN : Q16_MAX;
+
+  /* The high 16 bits of ua give quotient 0, start with them */
+  r = ua >> 16;
+  q = ua << 16;
+  for (i = 0; i < 32; i++) {
+    over = r >> 31;
+    r = (r << 1) | (q >> 31);
+    q <<= 1;
+    if (over || r >= ub) {
+      r -= ub;
+      q |= 1;
+    }
+  }
+
+  if (neg)
+    return q > 0x80000000UL ? Q16_MIN : -(int32)q;
+  return q > 0x7fffffffUL ? Q16_MAX : (int32)q;
+}
+
+/* sin of 0 to 90 degrees in 64 steps, times 256 */
+const uint16 q8_sin_table[65] = {
+    0,   6,  13,  19,  25,  31,  38,  44,
+   50,  56,  62,  68,  74,  80,  86,  92,
+   98, 104, 109, 115, 121, 126, 132, 137,
+  142, 147, 152, 157, 162, 167, 172, 177,
+  181, 185, 190, 194, 198, 202, 206, 209,
+  213, 216, 220, 223, 226, 229, 231, 234,
+  237, 239, 241, 243, 245, 247, 248, 250,
+  251, 252, 253, 254, 255, 255, 256, 256,
+  256
+};
+
+q8_8 q8_sin (byte angle)
+{
+  byte i = angle & 63;
+  q8_8 s;
+
+  s = q8_sin_table[angle & 64 ? 64 - i : i];
+  return angle & 128 ? -s : s;
+}
+
+q8_8 q8_cos (byte angle)
+{
+  return q8_sin(angle + 64);
+}
+
+/* Integer square root, a bit at a time */
+uint16 isqrt32 (uint32 x)
+{
+  uint32 bit, r;
+
+  r = 0;
+  bit = 0x40000000UL;
+  while (bit > x)
+    bit >>= 2;
+  while (bit) {
+    if (x >= r + bit) {
+      x -= r + bit;
+      r = (r >> 1) + bit;
+    } else
+      r >>= 1;
+    bit >>= 2;
+  }
+  return r;
+}
+
+/* sqrt(x); negative x gives 0 */
+q8_8 q8_sqrt (q8_8 x)
+{
+  if (x <= 0)
+    return 0;
+  return isqrt32((uint32)x << 8);
+}
+
+/* Packed BCD of x, 0 to 9999, one digit per nibble */
+uint16 bcd4 (uint16 x)
+{
+  uint16 hi, lo;
+
+  x = divxu(x, 100);                    /* x / 100 fits a byte           */
+  hi = divxu((byte)x, 10);
+  lo = divxu(x >> 8, 10);
+  return (byte)hi << 12 | (hi >> 8) << 8 | (byte)lo << 4 | lo >> 8;
+}
+
+#endif /* RCX_FIXED_H */
@@ -0,0 +1,219 @@
+/* RCX_H8.h
+ *
+ * H8/3292 on-chip registers, the RAM interrupt vectors of the RCX ROM
+ * and interrupt handler glue. See h3314.pdf for the registers.
+ */
+
+#ifndef RCX_H8_H
+#define RCX_H8_H
+
+#include "RCX_RTE.h"
+
+#define H8_REG8(a)    (*(volatile byte *)(a))
+#define H8_REG16(a)   (*(volatile word *)(a))
+
+/* Free-running timer (FRT) */
+#define T_IER         H8_REG8(0xff90)   /* interrupt enable             */
+#define T_CSR         H8_REG8(0xff91)   /* control/status               */
+#define T_CNT         H8_REG16(0xff92)  /* counter FRC                  */
+#define T_OCRA        H8_REG16(0xff94)  /* OCRA or OCRB, see T_OCR      */
+#define T_OCRB        H8_REG16(0xff94)
+#define T_CR          H8_REG8(0xff96)   /* control                      */
+#define T_OCR         H8_REG8(0xff97)   /* output compare control       */
+#define T_ICRA        H8_REG16(0xff98)  /* input capture A-D            */
+
+#define TIER_OCIAE    0x08              /* compare match A interrupt    */
+#define TIER_OCIBE    0x04              /* compare match B interrupt    */
+#define TIER_OVIE     0x02              /* overflow interrupt           */
+#define TCSR_OCFA     0x08              /* compare match A flag         */
+#define TCSR_OCFB     0x04              /* compare match B flag         */
+#define TCSR_OVF      0x02              /* overflow flag                */
+#define TCSR_CCLRA    0x01              /* clear FRC on compare match A */
+#define TCR_CLOCK_2   0x00              /* FRC clock phi/2              */
+#define TCR_CLOCK_8   0x01              /* FRC clock phi/8              */
+#define TCR_CLOCK_32  0x02              /* FRC clock phi/32             */
+#define TOCR_OCRS     0x10              /* select OCRB                  */
+
+/* 8-bit timers 0 and 1 */
+#define T0_CR         H8_REG8(0xffc8)
+#define T0_CSR        H8_REG8(0xffc9)
+#define T0_CORA       H8_REG8(0xffca)
+#define T0_CORB       H8_REG8(0xffcb)
+#define T0_CNT        H8_REG8(0xffcc)
+#define T1_CR         H8_REG8(0xffd0)
+#define T1_CSR        H8_REG8(0xffd1)
+#define T1_CORA       H8_REG8(0xffd2)
+#define T1_CORB       H8_REG8(0xffd3)
+#define T1_CNT        H8_REG8(0xffd4)
+
+#define TCR8_CMIEA    0x40              /* compare match A interrupt    */
+#define TCR8_CMIEB    0x80              /* compare match B interrupt    */
+#define TCR8_CLR_A    0x08              /* clear counter on match A     */
+#define TCR8_CLOCK_8  0x01              /* phi/8, phi/2 with ICKS       */
+#define TCR8_CLOCK_64 0x02              /* phi/64, phi/32 with ICKS     */
+#define TCR8_CLOCK_1024 0x03            /* phi/1024, phi/256 with ICKS  */
+#define TCSR8_CMFA    0x40              /* compare match A flag         */
+#define TCSR8_TOGGLE_A 0x03             /* toggle output on match A     */
+
+/* Serial communication interface (SCI), connected to the IR port */
+#define S_MR          H8_REG8(0xffd8)
+#define S_BRR         H8_REG8(0xffd9)
+#define S_CR          H8_REG8(0xffda)
+#define S_TDR         H8_REG8(0xffdb)
+#define S_SR          H8_REG8(0xffdc)
+#define S_RDR         H8_REG8(0xffdd)
+
+#define SCR_TIE       0x80              /* transmit interrupt           */
+#define SCR_RIE       0x40              /* receive interrupt            */
+#define SCR_TE        0x20              /* transmitter on               */
+#define SCR_RE        0x10              /* receiver on                  */
+#define SCR_TEIE      0x04              /* transmit end interrupt       */
+#define SSR_TDRE      0x80              /* transmit data register empty */
+#define SSR_RDRF      0x40              /* receive data register full   */
+#define SSR_ORER      0x20              /* overrun error                */
+#define SSR_FER       0x10              /* framing error                */
+#define SSR_PER       0x08              /* parity error                 */
+#define SSR_TEND      0x04              /* transmit end                 */
+
+/* A/D converter. Results are left aligned 10 bit values. */
+#define AD_A          H8_REG16(0xffe0)  /* AN0, sensor 3                */
+#define AD_B          H8_REG16(0xffe2)  /* AN1, sensor 2                */
+#define AD_C          H8_REG16(0xffe4)  /* AN2, sensor 1                */
+#define AD_D          H8_REG16(0xffe6)  /* AN3, battery                 */
+#define AD_CSR        H8_REG8(0xffe8)
+#define AD_CR         H8_REG8(0xffe9)
+
+#define ADCSR_ADF     0x80              /* conversion end flag          */
+#define ADCSR_ADIE    0x40              /* conversion end interrupt     */
+#define ADCSR_ADST    0x20              /* start                        */
+#define ADCSR_SCAN    0x10              /* scan mode                    */
+#define ADCSR_CKS     0x08              /* fast conversion clock        */
+
+/* I/O ports */
+#define PORT1_DDR     H8_REG8(0xffb0)
+#define PORT2_DDR     H8_REG8(0xffb1)
+#define PORT1         H8_REG8(0xffb2)
+#define PORT2         H8_REG8(0xffb3)
+#define PORT3_DDR     H8_REG8(0xffb4)
+#define PORT4_DDR     H8_REG8(0xffb5)
+#define PORT3         H8_REG8(0xffb6)
+#define PORT4         H8_REG8(0xffb7)
+#define PORT5_DDR     H8_REG8(0xffb8)
+#define PORT6_DDR     H8_REG8(0xffb9)
+#define PORT5         H8_REG8(0xffba)
+#define PORT6         H8_REG8(0xffbb)
+#define PORT7         H8_REG8(0xffbe)   /* input only                   */
+
+/* System control */
+#define STCR          H8_REG8(0xffc3)
+#define SYSCR         H8_REG8(0xffc4)
+#define ISCR          H8_REG8(0xffc6)   /* IRQ sense control            */
+#define IER           H8_REG8(0xffc7)   /* IRQ enable                   */
+
+#define SYSCR_SSBY    0x80              /* sleep enters software standby */
+#define STCR_ICKS0    0x01              /* timer 0 clock select         */
+#define STCR_ICKS1    0x02              /* timer 1 clock select         */
+
+/* Motor driver, outputs A, B and C */
+#define MOTOR         H8_REG8(0xf000)
+
+/* Buttons, low active port bits */
+#define BUTTON_ONOFF  0x02              /* PORT4 bit 1, IRQ1            */
+#define BUTTON_RUN    0x04              /* PORT4 bit 2, IRQ0            */
+#define BUTTON_VIEW   0x40              /* PORT7 bit 6                  */
+#define BUTTON_PRGM   0x80              /* PORT7 bit 7                  */
+#define BUTTON_ALL    0xc6
+
+/* The buttons pressed now */
+static inline byte button_state (void)
+{
+  return ~((PORT4 & (BUTTON_ONOFF | BUTTON_RUN)) |
+           (PORT7 & (BUTTON_VIEW | BUTTON_PRGM))) & BUTTON_ALL;
+}
+
+/* RAM interrupt vectors. The ROM dispatches each interrupt through
+ * these words with jsr, after saving r6, and returns with rte. A
+ * handler is therefore a subroutine that ends with rts and must save
+ * all registers it uses except r6; see RCX_HANDLER.
+ */
+typedef void (*vector)(void);
+
+#define H8_VECTOR(a)  (*(vector *)(a))
+
+#define nmi_vector    H8_VECTOR(0xfd92)
+#define irq0_vector   H8_VECTOR(0xfd94) /* run button                   */
+#define irq1_vector   H8_VECTOR(0xfd96) /* on/off button                */
+#define irq2_vector   H8_VECTOR(0xfd98)
+#define icia_vector   H8_VECTOR(0xfd9a)
+#define icib_vector   H8_VECTOR(0xfd9c)
+#define icic_vector   H8_VECTOR(0xfd9e)
+#define icid_vector   H8_VECTOR(0xfda0)
+#define ocia_vector   H8_VECTOR(0xfda2)
+#define ocib_vector   H8_VECTOR(0xfda4)
+#define fovi_vector   H8_VECTOR(0xfda6)
+#define cmi0a_vector  H8_VECTOR(0xfda8)
+#define cmi0b_vector  H8_VECTOR(0xfdaa)
+#define ovi0_vector   H8_VECTOR(0xfdac)
+#define cmi1a_vector  H8_VECTOR(0xfdae)
+#define cmi1b_vector  H8_VECTOR(0xfdb0)
+#define ovi1_vector   H8_VECTOR(0xfdb2)
+#define eri_vector    H8_VECTOR(0xfdb4)
+#define rxi_vector    H8_VECTOR(0xfdb6)
+#define txi_vector    H8_VECTOR(0xfdb8)
+#define tei_vector    H8_VECTOR(0xfdba)
+#define adi_vector    H8_VECTOR(0xfdbc)
+#define wovf_vector   H8_VECTOR(0xfdbe)
+
+/* RCX_HANDLER(name, function) defines a handler name for a RAM vector
+ * that calls the C function function. The C function saves r4 and r5
+ * itself if it uses them; the handler saves r0-r3, which a C function
+ * may change, and the ROM has saved r6.
+ */
+#define RCX_HANDLER(name, function)                              \
+  void name (void);                                              \
+  asm (".section .text\n\t"                                      \
+       ".align 1\n"                                              \
+       "_" #name ":\n\t"                                         \
+       "push r0\n\t"                                             \
+       "push r1\n\t"                                             \
+       "push r2\n\t"                                             \
+       "push r3\n\t"                                             \
+       "jsr @_" #function "\n\t"                                 \
+       "pop r3\n\t"                                              \
+       "pop r2\n\t"                                              \
+       "pop r1\n\t"                                              \
+       "pop r0\n\t"                                              \
+       "rts")
+
+/* Interrupt mask. irq_save returns the old mask for irq_restore. */
+static inline void irq_disable (void)
+{ asm volatile ("orc #0x80,ccr" : : : "memory");
+}
+
+static inline void irq_enable (void)
+{ asm volatile ("andc #0x7f,ccr" : : : "memory");
+}
+
+static inline byte irq_save (void)
+{ byte ccr;
+
+  asm volatile ("stc ccr,%0\n\t"
+                "orc #0x80,ccr" : "=r" (ccr) : : "memory");
+  return ccr;
+}
+
+static inline void irq_restore (byte ccr)
+{ asm volatile ("ldc %0,ccr" : : "r" (ccr) : "memory");
+}
+
+/* Enable interrupts and sleep until the next one. No interrupt is
+ * accepted between the andc and the sleep, so an interrupt that
+ * arrives after a caller checked for work with interrupts disabled
+ * still ends the sleep.
+ */
+static inline void irq_enable_sleep (void)
+{ asm volatile ("andc #0x7f,ccr\n\t"
+                "sleep" : : : "memory");
+}
+
+#endif /* RCX_H8_H */
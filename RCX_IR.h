@@ -0,0 +1,180 @@
+/*
+ *  RCX_IR.h
+ *
+ *  IR requests of the host tools that talk to programs of the runtime,
+ *  rcxprof, rcxbench, rcxmsg and rcxlog. Packets have the format of
+ *  the ROM, see RCX_Download.c, and are answered by serial_send of
+ *  RCX_Serial.h.
+ *
+ *  IR_open:    opens the port of RCX_Tower.h at 2400 bit/sec, odd
+ *              parity; a read returns after 0.1 s of silence.
+ *  IR_request: sends a request and returns the reply.
+ *  IR_frame:   builds the packet of a request once, for IR_send.
+ *  IR_send:    sends a packet and waits only for its echo, so that
+ *              packets go out back to back without the 0.1 s wait.
+ *  IR_reply:   reads a reply of known length, returning as soon as it
+ *              is complete.
+ *------------------------------------------------------------------------
+ */
+
+#ifndef RCX_IR_H
+#define RCX_IR_H
+
+#include "RCX_Tower.h"  /* RCX_tower_name: RCX_IR, cached or discovered port */
+
+typedef unsigned char byte;
+
+#define IR_MAXSIZE  256
+#define IR_TRIES    5
+
+int IR_open(void)
+{
+    int fd;
+    char * IR_Name;
+    struct termios ios;
+
+    IR_Name = RCX_tower_name();
+
+    if ((fd = open(IR_Name, O_RDWR)) < 0) {
+        printf("Open Infraread failed. Name of RCX_IR = %s. \n", IR_Name);
+        exit(1);
+    }
+
+    if (!isatty(fd)) {
+        close(fd);
+        printf("IR = %s is not the name of a serial port.\n", IR_Name);
+        exit(1);
+    }
+
+    memset(&ios, 0, sizeof(ios));
+    ios.c_cflag = CREAD | CLOCAL | CS8 | PARENB | PARODD;
+    cfsetispeed(&ios, B2400);
+    cfsetospeed(&ios, B2400);
+
+    ios.c_cc[VTIME] = 1;
+    ios.c_cc[VMIN]  = 0;
+
+    if (tcsetattr(fd, TCSANOW, &ios) == -1) {
+        perror("tcsetattr");
+        exit(1);
+    }
+
+    return fd;
+}
+
+/* Put the packet of a request of length bytes in m: header, byte and
+ * complement pairs, checksum pair. Returns the size of the packet.
+ */
+int IR_frame(byte * req, int length, byte * m)
+{
+    byte sum;
+    int i, j;
+
+    m[0] = 0x55;
+    m[1] = 0xff;
+    m[2] = 0x00;
+    sum = 0;
+    for (i = 0, j = 3; i < length; i++, j += 2) {
+        m[j]     =  req[i];
+        m[j + 1] = ~req[i];
+        sum     +=  req[i];
+    }
+    m[j]     =  sum;
+    m[j + 1] = ~sum;
+    return j + 2;
+}
+
+/* Read up to count bytes; stops early after 0.1 s of silence */
+int IR_read(int fd, byte * bs, int count)
+{
+    int n, received = 0;
+
+    while (received < count) {
+        if ((n = read(fd, &bs[received], count - received)) == -1) {
+            printf("Error in read.\n");
+            exit(1);
+        }
+        if (n == 0)
+            break;
+        received += n;
+    }
+    return received;
+}
+
+/* Decode the packet of received bytes in bs to reply. Returns the
+ * length of the reply, or -1 if it is not intact.
+ */
+int IR_decode(byte * bs, int received, byte * reply)
+{
+    byte sum;
+    int i, j;
+
+    if (received < 5 || bs[0] != 0x55 || bs[1] != 0xff || bs[2] != 0x00 ||
+        (received - 3) % 2)
+        return -1;
+    sum = 0;
+    for (i = 3, j = 0; i < received - 2; i += 2, j++) {
+        if (bs[i] != (byte)~bs[i + 1])
+            return -1;
+        reply[j] = bs[i];
+        sum += bs[i];
+    }
+    if (bs[i] != sum || bs[i + 1] != (byte)~sum)
+        return -1;
+    return j;
+}
+
+/* Send the packet m of n bytes and read back the echo of the tower.
+ * Returns 0, or -1 if the echo was garbled.
+ */
+int IR_send(int fd, byte * m, int n)
+{
+    byte bs[IR_MAXSIZE];
+
+    if (write(fd, m, n) != n) {
+        printf("Error in write.\n");
+        exit(1);
+    }
+    if (IR_read(fd, bs, n) != n || memcmp(bs, m, n))
+        return -1;
+    return 0;
+}
+
+/* Read a reply of length bytes. Returns its length, or -1. */
+int IR_reply(int fd, byte * reply, int length)
+{
+    byte bs[IR_MAXSIZE];
+
+    return IR_decode(bs, IR_read(fd, bs, 3 + 2 * (length + 1)), reply);
+}
+
+/* Send a request of length bytes and copy the reply to reply. The
+ * request is sent again until a reply arrives intact whose first byte
+ * is the complement of the opcode. Returns the length of the reply,
+ * or -1.
+ */
+int IR_request(int fd, byte * req, int length, byte * reply)
+{
+    byte m[IR_MAXSIZE], bs[IR_MAXSIZE];
+    int n, j, received, tries;
+
+    n = IR_frame(req, length, m);
+
+    for (tries = 0; tries < IR_TRIES; tries++) {
+        if (write(fd, m, n) != n) {
+            printf("Error in write.\n");
+            exit(1);
+        }
+        received = IR_read(fd, bs, IR_MAXSIZE);
+
+        /* Echo, then the reply */
+        if (received < n || memcmp(bs, m, n))
+            continue;
+        j = IR_decode(&bs[n], received - n, reply);
+        if (j > 0 && reply[0] == (byte)~req[0])
+            return j;
+    }
+    return -1;
+}
+
+#endif /* RCX_IR_H */
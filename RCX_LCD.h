@@ -0,0 +1,194 @@
+/* RCX_LCD.h
+ *
+ * LCD frame buffer. The lcd_* routines of RCX_RTE.h call the ROM
+ * refresh routine (0x27c8) after every change, and each refresh
+ * sends the whole display to the LCD controller. The lcd_fb_*
+ * routines below only change a RAM shadow of the display.
+ * lcd_fb_flush, called once per frame, hands the icons and the number
+ * that changed since the last flush to the ROM and refreshes the LCD
+ * once. A flush with nothing changed costs a few compares.
+ */
+
+#ifndef RCX_LCD_H
+#define RCX_LCD_H
+
+#include "RCX_RTE.h"
+
+/* ROM LCD routines without refresh. They only change the display
+ * buffer of the ROM.
+ */
+void lcd_set_icon (uint16 icon)
+{ asm volatile ("push r6\n\t"
+                "mov.w %0,r6\n\t"
+                "jsr 0x1b62      ; call show_icon\n\t"
+                "pop r6"
+                : : "r" (icon) : "r0", "r1", "r2", "r3", "cc", "memory");
+}
+
+void lcd_reset_icon (uint16 icon)
+{ asm volatile ("push r6\n\t"
+                "mov.w %0,r6\n\t"
+                "jsr 0x1e4a      ; call hide_icon\n\t"
+                "pop r6"
+                : : "r" (icon) : "r0", "r1", "r2", "r3", "cc", "memory");
+}
+
+void lcd_set_number (int16 format, int16 value, int16 scalecode)
+{ asm volatile ("push r6\n\t"
+                "push %2\n\t"
+                "push %1\n\t"
+                "mov.w %0,r6\n\t"
+                "jsr 0x1ff2      ; call show_number\n\t"
+                "adds #2,r7      ; adjust stack\n\t"
+                "adds #2,r7\n\t"
+                "pop r6"
+                : : "r" (format), "r" (value), "r" (scalecode)
+                : "r0", "r1", "r2", "r3", "cc", "memory");
+}
+
+void lcd_update (void)
+{ asm volatile ("push r6\n\t"
+                "jsr 0x27c8      ; call refresh\n\t"
+                "pop r6"
+                : : : "r0", "r1", "r2", "r3", "cc", "memory");
+}
+
+void lcd_reset (void)
+{ asm volatile ("push r6\n\t"
+                "jsr 0x27ac      ; call clear\n\t"
+                "pop r6"
+                : : : "r0", "r1", "r2", "r3", "cc", "memory");
+}
+
+
+/* Shadow of the display.
+ *
+ * Icons LCD_STANDING to LCD_ALL are one bit each, indexed by the icon
+ * code minus LCD_STANDING. want holds the display the program asked
+ * for, shown what the ROM buffer holds. The number is shown with
+ * format 0x3001 (four digits) or 0x3017 (one digit) as by
+ * lcd_show_int16 and lcd_show_digit; format 0 means no number.
+ */
+#define LCD_FB_ICONS   (LCD_ALL - LCD_STANDING + 1)
+#define LCD_FB_BYTES   ((LCD_FB_ICONS + 7) / 8)
+
+#define LCD_FB_INT16   0x3001
+#define LCD_FB_DIGIT   0x3017
+
+struct lcd_fb_number { int16 format;
+                       int16 value;
+                       int16 scalecode;
+                     };
+
+struct lcd_fb { byte want[LCD_FB_BYTES];
+                byte shown[LCD_FB_BYTES];
+                struct lcd_fb_number want_number;
+                struct lcd_fb_number shown_number;
+                byte clear;            /* ROM buffer must be cleared */
+              };
+
+struct lcd_fb lcd_fb;
+
+void lcd_fb_show_icon (uint16 icon)
+{
+  icon -= LCD_STANDING;
+  lcd_fb.want[icon >> 3] |= 1 << (icon & 7);
+}
+
+void lcd_fb_hide_icon (uint16 icon)
+{
+  icon -= LCD_STANDING;
+  lcd_fb.want[icon >> 3] &= ~(1 << (icon & 7));
+}
+
+void lcd_fb_show_number (int16 format, int16 value, int16 scalecode)
+{
+  lcd_fb.want_number.format    = format;
+  lcd_fb.want_number.value     = value;
+  lcd_fb.want_number.scalecode = scalecode;
+}
+
+/* As lcd_show_int16: four digits left of the LEGO man */
+void lcd_fb_show_int16 (int16 r)
+{
+  lcd_fb_show_number(LCD_FB_INT16, r, 0x3002);
+}
+
+/* As lcd_show_digit */
+void lcd_fb_show_digit (int16 r)
+{
+  lcd_fb_show_number(LCD_FB_DIGIT, r, 0);
+}
+
+/* Hide all icons and the number */
+void lcd_fb_clear (void)
+{
+  byte i;
+
+  for (i = 0; i < LCD_FB_BYTES; i++)
+    lcd_fb.want[i] = 0;
+  lcd_fb.want_number.format = 0;
+}
+
+/* Start from a cleared display. Call before the first lcd_fb_flush. */
+void lcd_fb_init (void)
+{
+  lcd_fb_clear();
+  lcd_fb.clear = 1;
+}
+
+/* Hand the changes since the last flush to the ROM and refresh the
+ * LCD once. Returns 0 if nothing had changed; the LCD is then not
+ * refreshed.
+ */
+byte lcd_fb_flush (void)
+{
+  struct lcd_fb_number *want = &lcd_fb.want_number;
+  struct lcd_fb_number *shown = &lcd_fb.shown_number;
+  byte i, bit, diff, dirty;
+
+  dirty = 0;
+
+  /* A number can only be removed by clearing the whole buffer */
+  if (shown->format != 0 && want->format == 0)
+    lcd_fb.clear = 1;
+
+  if (lcd_fb.clear) {
+    lcd_reset();
+    for (i = 0; i < LCD_FB_BYTES; i++)
+      lcd_fb.shown[i] = 0;
+    shown->format = 0;
+    lcd_fb.clear = 0;
+    dirty = 1;
+  }
+
+  for (i = 0; i < LCD_FB_BYTES; i++) {
+    diff = lcd_fb.want[i] ^ lcd_fb.shown[i];
+    if (diff == 0)
+      continue;
+    for (bit = 0; bit < 8; bit++)
+      if (diff & (1 << bit)) {
+        if (lcd_fb.want[i] & (1 << bit))
+          lcd_set_icon(LCD_STANDING + (i << 3) + bit);
+        else
+          lcd_reset_icon(LCD_STANDING + (i << 3) + bit);
+      }
+    lcd_fb.shown[i] = lcd_fb.want[i];
+    dirty = 1;
+  }
+
+  if (want->format != 0 &&
+      (want->format != shown->format || want->value != shown->value ||
+       want->scalecode != shown->scalecode)) {
+    lcd_set_number(want->format, want->value, want->scalecode);
+    *shown = *want;
+    dirty = 1;
+  }
+
+  if (dirty)
+    lcd_update();
+
+  return dirty;
+}
+
+#endif /* RCX_LCD_H */
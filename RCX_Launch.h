@@ -0,0 +1,80 @@
+/* RCX_Launch.h
+ *
+ * Programs of a bundle, see BUNDLE in the Makefile: several programs
+ * downloaded together, each linked on its own behind the one before,
+ * and the launcher launch.c at 0x8000. The launcher shows the number
+ * of the selected program; Prgm selects the next, Run starts it. In a
+ * program that calls launch_init, Run goes back to the launcher:
+ *
+ *   sched_init();
+ *   serial_init(task_create(command_run));
+ *   launch_init();
+ *
+ * and a command task that passes requests to launch_command lets the
+ * host start any program at once, in the launcher or in a program:
+ *
+ *   0xf6 n          start program n, from 0, or the launcher for
+ *                   0xff; reply 0x09 before the switch
+ *
+ * The launcher puts the hardware back as the ROM left it, see
+ * RCX_Boot.h, and starts the program at its crt0.s: the first time
+ * at __start, later at __restart, which gives it back its .data as
+ * downloaded, see RCX_Restart.h.
+ *
+ * launch(n) switches from a program without a request. The launcher
+ * is called through the jump at LAUNCH_SWITCH, the load address, so
+ * all of this works only in a program of a bundle.
+ */
+
+#ifndef RCX_LAUNCH_H
+#define RCX_LAUNCH_H
+
+#include "RCX_Serial.h"
+
+#define LAUNCH_SWITCH   0x8000          /* jmp @_launch_switch          */
+#define LAUNCH_MENU     0xff
+#define LAUNCH_MAX      8               /* programs in a bundle         */
+#define LAUNCH_POLL_MS  20
+#define LAUNCH_WARM     2               /* __restart - __start, crt0.s  */
+
+#define LAUNCH_REQUEST  0xf6
+
+byte launch_run_down;
+
+static inline void launch (byte n)
+{
+  ((void (*)(byte))LAUNCH_SWITCH)(n);
+}
+
+/* Run button: back to the launcher when it is pressed */
+void launch_poll (void)
+{
+  byte down = (button_state() & BUTTON_RUN) != 0;
+
+  if (down && !launch_run_down)
+    launch(LAUNCH_MENU);
+  launch_run_down = down;
+}
+
+/* Watch the run button. Needs sched_init first. */
+void launch_init (void)
+{
+  launch_run_down = (button_state() & BUTTON_RUN) != 0;
+  task_every(task_create(launch_poll), LAUNCH_POLL_MS);
+}
+
+/* Answer a launch request, then switch. Returns 0 if cmd is not one. */
+byte launch_command (const byte *cmd, byte n)
+{
+  byte reply[1];
+
+  if ((cmd[0] & ~0x08) != LAUNCH_REQUEST || n < 2)
+    return 0;
+  reply[0] = ~cmd[0];
+  serial_send(reply, 1);
+  serial_drain(500);                    /* before the port is reset     */
+  launch(cmd[1]);
+  return 1;
+}
+
+#endif /* RCX_LAUNCH_H */
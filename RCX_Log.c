@@ -0,0 +1,172 @@
+/*
+ *  RCX_Log.c
+ *
+ *  Host side of the datalog of RCX_Log.h. Starts and stops recording
+ *  on the brick, uploads the log over IR and prints one line per
+ *  record.
+ *
+ *  Under UNIX systems like IRIX, Linux, and Solaris, this program compiles
+ *  with gcc RCX_Log.c -o rcxlog.
+ *
+ *  Usage:
+ *
+ *     rcxlog start            clear the log and start recording
+ *     rcxlog stop             stop recording
+ *     rcxlog                  stop recording, upload and print the log
+ *
+ *  Each line holds the time in ms since the first record if the log
+ *  has LOG_TIME, then the values, signed. The blocks of the log are
+ *  read with requests of known reply length, so each one returns as
+ *  soon as its reply is complete, without the 0.1 s wait of
+ *  IR_request.
+ *
+ *  The RS232 port connected to the infrared transmitter/receiver is
+ *  found as described in RCX_Tower.h. Set the RCX_IR environment
+ *  variable to the name of the port to skip discovery.
+ *------------------------------------------------------------------------
+ */
+
+#include <stdio.h>      /* printf                                        */
+#include <stdlib.h>     /* malloc, exit                                  */
+#include <string.h>     /* strcmp                                        */
+
+#include "RCX_IR.h"     /* IR_open, IR_request, IR_frame, IR_send, IR_reply */
+
+#define LOG_DELTA      1        /* formats of RCX_Log.h                  */
+#define LOG_RING       2
+#define LOG_TIME       4
+#define LOG_ESCAPE     0x80
+#define LOG_STATE      0xc6     /* requests of RCX_Log.h                 */
+#define LOG_READ       0xd6
+#define LOG_START      0xe6
+#define LOG_READ_MAX   28
+#define LOG_CHANNELS   9        /* with the time                         */
+
+int get16(byte * p)
+{
+    return p[0] | p[1] << 8;
+}
+
+/* Read count bytes of the log from offset into buf */
+int read_block(int fd, int offset, int count, byte * buf)
+{
+    byte req[4], m[IR_MAXSIZE], reply[IR_MAXSIZE];
+    int n, tries;
+
+    req[0] = LOG_READ | ((offset / LOG_READ_MAX) & 1) << 3;
+    req[1] = offset;
+    req[2] = offset >> 8;
+    req[3] = count;
+    n = IR_frame(req, 4, m);
+    for (tries = 0; tries < IR_TRIES; tries++)
+        if (IR_send(fd, m, n) == 0 &&
+            IR_reply(fd, reply, 1 + count) == 1 + count &&
+            reply[0] == (byte)~req[0]) {
+            memcpy(buf, &reply[1], count);
+            return 0;
+        }
+    return -1;
+}
+
+/* Print the records of the log of length bytes */
+void print_log(byte * log, int length, int format, int channels)
+{
+    unsigned short value[LOG_CHANNELS];
+    unsigned long now = 0, origin = 0;
+    int i, j, first;
+
+    memset(value, 0, sizeof(value));
+    for (i = 0, first = 1; i < length; first = 0) {
+        for (j = 0; j < channels; j++) {
+            if (!(format & LOG_DELTA)) {
+                if (i + 2 > length)
+                    return;
+                value[j] = get16(&log[i]);
+                i += 2;
+            } else if (i < length && log[i] == LOG_ESCAPE) {
+                if (i + 3 > length)
+                    return;
+                value[j] = get16(&log[i + 1]);
+                i += 3;
+            } else if (i < length)
+                value[j] += (signed char)log[i++];
+            else
+                return;
+        }
+        j = 0;
+        if (format & LOG_TIME) {
+            if (first)
+                now = origin = value[0];
+            else
+                now += (unsigned short)(value[0] - now);
+            printf("%8lu", now - origin);
+            j = 1;
+        }
+        for (; j < channels; j++)
+            printf(" %6d", (short)value[j]);
+        printf("\n");
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    byte req[2], reply[IR_MAXSIZE], *log;
+    int fd, format, channels, length, records, lost, offset, count;
+
+    if (argc > 2 || (argc == 2 && strcmp(argv[1], "start") &&
+                     strcmp(argv[1], "stop"))) {
+        printf("usage: %s [start | stop]\n", argv[0]);
+        exit(1);
+    }
+
+    fd = IR_open();
+
+    req[0] = LOG_START;
+    req[1] = argc == 2 && !strcmp(argv[1], "start");
+    if (IR_request(fd, req, 2, reply) < 0) {
+        printf("No answer from the datalog.\n");
+        exit(1);
+    }
+    if (argc == 2) {
+        close(fd);
+        exit(0);
+    }
+
+    req[0] = LOG_STATE;
+    if (IR_request(fd, req, 1, reply) != 10) {
+        printf("No answer from the datalog.\n");
+        exit(1);
+    }
+    format   = reply[1];
+    channels = reply[2];
+    length   = get16(&reply[3]);
+    records  = get16(&reply[5]);
+    lost     = get16(&reply[7]);
+    if (channels < 1 || channels > LOG_CHANNELS) {
+        printf("Bad datalog state.\n");
+        exit(1);
+    }
+
+    if ((log = malloc(length + 1)) == NULL) {
+        printf("Out of memory.\n");
+        exit(1);
+    }
+    for (offset = 0; offset < length; offset += count) {
+        count = length - offset < LOG_READ_MAX ? length - offset : LOG_READ_MAX;
+        if (read_block(fd, offset, count, &log[offset]) < 0) {
+            printf("No answer from the datalog at byte %d.\n", offset);
+            exit(1);
+        }
+        fprintf(stderr, "\r%d of %d bytes", offset + count, length);
+    }
+    if (length)
+        fprintf(stderr, "\n");
+    close(fd);
+
+    print_log(log, length, format, channels);
+    fprintf(stderr, "%d bytes, %d records, %d %s\n", length,
+            format & LOG_DELTA ? records : length / (2 * channels), lost,
+            format & LOG_RING ? "overwritten" : "lost");
+
+    exit(0);
+}
@@ -0,0 +1,228 @@
+/* RCX_Log.h
+ *
+ * Datalog in RAM, for sample rates far above what the IR link carries
+ * live. Records of up to LOG_CHANNELS 16-bit values go into a buffer
+ * from the arena of RCX_Alloc.h, between __end and the stack, and
+ * rcxlog uploads and decodes them after the run.
+ *
+ *   alloc_init();
+ *   log_init(LOG_DELTA | LOG_TIME, 2, 0);      all free arena
+ *   ...
+ *   v[0] = sensor_raw(0); v[1] = motor_speed;
+ *   log_record(v);
+ *
+ * Formats, or-ed together:
+ *
+ *   LOG_WORDS   each value as a word
+ *   LOG_DELTA   each value as the change since the record before, one
+ *               byte for -127..127, else 0x80 and the value as a word,
+ *               low byte first. The first record holds the values.
+ *   LOG_RING    with LOG_WORDS, overwrite the oldest records when the
+ *               buffer is full instead of dropping the new ones
+ *   LOG_TIME    time_ticks() before the values, logged like them
+ *
+ * log_record masks interrupts while it writes, so it may be called
+ * from tasks and interrupt handlers alike; a record of two words costs
+ * some 100 states, 6 us. Records that do not fit are counted in lost.
+ *
+ * Requests, in the format of the helper of download -v, bit 3 of the
+ * opcode ignored, 16-bit values low byte first:
+ *
+ *   0xc6                state, reply 0x39 format channels length(2)
+ *                       records(2) lost(2) on
+ *   0xd6 offset(2) n    n <= 28 bytes from offset, the oldest byte at 0,
+ *                       reply 0x29 bytes
+ *   0xe6 on             start (clears) or stop, reply 0x19
+ */
+
+#ifndef RCX_LOG_H
+#define RCX_LOG_H
+
+#include "RCX_Alloc.h"
+#include "RCX_Time.h"
+#include "RCX_Serial.h"
+
+#define LOG_WORDS       0
+#define LOG_DELTA       1
+#define LOG_RING        2
+#define LOG_TIME        4
+
+#define LOG_CHANNELS    8
+#define LOG_ESCAPE      0x80
+
+#define LOG_STATE       0xc6
+#define LOG_READ        0xd6
+#define LOG_START       0xe6
+#define LOG_READ_MAX    28
+
+struct log { byte *start, *end;         /* the buffer                   */
+             byte *head;                /* next byte written            */
+             byte wrapped;              /* ring: head is the oldest     */
+             byte on;
+             byte format;
+             byte channels;             /* with the time                */
+             byte record;               /* bytes, most with LOG_DELTA   */
+             uint16 records;
+             uint16 lost;
+             uint16 last[LOG_CHANNELS + 1];
+           };
+
+struct log log_state;
+
+/* Clear the log and start recording */
+void log_start (void)
+{
+  struct log *l = &log_state;
+  byte ccr, i;
+
+  ccr = irq_save();
+  l->head = l->start;
+  l->wrapped = 0;
+  l->records = l->lost = 0;
+  for (i = 0; i < l->channels; i++)
+    l->last[i] = 0;
+  l->on = 1;
+  irq_restore(ccr);
+}
+
+static inline void log_stop (void)
+{
+  log_state.on = 0;
+}
+
+/* A log of channels values per record in format, in bytes of the
+ * arena, or all of it if bytes is 0. Starts recording. Returns 0 if
+ * the arena has too little room. Needs alloc_init first.
+ */
+byte log_init (byte format, byte channels, uint16 bytes)
+{
+  struct log *l = &log_state;
+
+  if (channels > LOG_CHANNELS)
+    channels = LOG_CHANNELS;
+  l->format = format;
+  l->channels = channels + ((format & LOG_TIME) != 0);
+  l->record = (format & LOG_DELTA ? 3 : 2) * l->channels;
+  if (bytes == 0)
+    bytes = arena_free();
+  if (!(format & LOG_DELTA))
+    bytes -= bytes % l->record;
+  if (bytes < l->record || (l->start = arena_alloc(bytes)) == 0)
+    return 0;
+  l->end = l->start + bytes;
+  log_start();
+  return 1;
+}
+
+/* Log one record of the values v */
+void log_record (const uint16 *v)
+{
+  struct log *l = &log_state;
+  byte *p, ccr, i;
+  uint16 x, *w;
+  int16 d;
+
+  ccr = irq_save();
+  if (!l->on)
+    goto out;
+  p = l->head;
+  if (l->end - p < l->record) {
+    if (!(l->format & LOG_RING) || (l->format & LOG_DELTA)) {
+      l->lost++;
+      goto out;
+    }
+    p = l->start;
+    l->wrapped = 1;
+  }
+
+  if (!(l->format & LOG_DELTA)) {
+    w = (uint16 *)p;
+    if (l->format & LOG_TIME)
+      *w++ = time_ticks();
+    for (i = l->channels - ((l->format & LOG_TIME) != 0); i > 0; i--)
+      *w++ = *v++;
+    p = (byte *)w;
+    if (l->wrapped)
+      l->lost++;
+    else
+      l->records++;
+  } else {
+    for (i = 0; i < l->channels; i++) {
+      x = (l->format & LOG_TIME) && i == 0 ? time_ticks() : *v++;
+      d = x - l->last[i];
+      l->last[i] = x;
+      if (d >= -127 && d <= 127)
+        *p++ = d;
+      else {
+        *p++ = LOG_ESCAPE;
+        *p++ = x;
+        *p++ = x >> 8;
+      }
+    }
+    l->records++;
+  }
+  l->head = p;
+out:
+  irq_restore(ccr);
+}
+
+/* Bytes in the log */
+uint16 log_length (void)
+{
+  struct log *l = &log_state;
+
+  return l->wrapped ? l->end - l->start : l->head - l->start;
+}
+
+/* Answer a datalog request. Returns 0 if cmd is not one. */
+byte log_command (const byte *cmd, byte n)
+{
+  struct log *l = &log_state;
+  byte reply[1 + LOG_READ_MAX], *p, count;
+  uint16 offset, length, i;
+
+  reply[0] = ~cmd[0];
+  p = &reply[1];
+
+  switch (cmd[0] & ~0x08) {
+  case LOG_STATE:
+    length = log_length();
+    *p++ = l->format;
+    *p++ = l->channels;
+    *p++ = length;
+    *p++ = length >> 8;
+    *p++ = l->records;
+    *p++ = l->records >> 8;
+    *p++ = l->lost;
+    *p++ = l->lost >> 8;
+    *p++ = l->on;
+    break;
+  case LOG_READ:
+    if (n < 4)
+      return 1;
+    offset = cmd[1] | cmd[2] << 8;
+    count = cmd[3] < LOG_READ_MAX ? cmd[3] : LOG_READ_MAX;
+    length = log_length();
+    /* An index, not a pointer: head + offset may pass 0xffff */
+    i = (l->wrapped ? l->head - l->start : 0) + offset;
+    for (; count > 0 && offset < length; count--, offset++) {
+      if (i >= length)
+        i -= length;
+      *p++ = l->start[i++];
+    }
+    break;
+  case LOG_START:
+    if (n >= 2 && cmd[1])
+      log_start();
+    else
+      log_stop();
+    break;
+  default:
+    return 0;
+  }
+
+  serial_send(reply, p - reply);
+  return 1;
+}
+
+#endif /* RCX_LOG_H */
@@ -0,0 +1,167 @@
+/*
+ *  RCX_Map.h
+ *
+ *  The linker map of a program, as written by GNU ld with -Map, see
+ *  the Makefile. Read by the host tools rcxsize, rcxsim and rcxprof.
+ *
+ *  read_map collects
+ *    output sections:  ".text  0x00008000  0x5c"
+ *    input sections:   " .text  0x00008000  0x3a reset.o"
+ *    fills:            " *fill*  0x0000803a  0x2"
+ *    symbols:          "         0x00008000   __start"
+ *  A section name too long for its column, as most of those of
+ *  -ffunction-sections are, is followed by a line with the rest; the
+ *  two are read as one.
+ *
+ *  map_symbols:  the symbols of an address range, one per address.
+ *  map_section:  an output section by name.
+ *------------------------------------------------------------------------
+ */
+
+#ifndef RCX_MAP_H
+#define RCX_MAP_H
+
+#include <stdio.h>      /* fopen, fgets, snprintf                        */
+#include <stdlib.h>     /* qsort, exit                                   */
+#include <string.h>     /* strcmp, strncpy                               */
+
+#define MAX_ITEMS   4096
+#define NAME_LEN    128
+
+enum item_types { OUTPUT_SECTION, INPUT_SECTION, FILL, SYMBOL };
+
+struct item_t { int  type;
+                long addr;
+                long size;
+                char name[NAME_LEN];
+                char file[NAME_LEN];
+              };
+typedef struct item_t item;
+
+struct map_t { item items[MAX_ITEMS];
+               int  count;
+             };
+typedef struct map_t map;
+
+void add_item(map * m, int type, long addr, long size, char * name,
+              char * file)
+{
+    item *it;
+
+    if (m->count == MAX_ITEMS) {
+        fprintf(stderr, "map too large\n");
+        exit(1);
+    }
+    it = &m->items[m->count++];
+    it->type = type;
+    it->addr = addr;
+    it->size = size;
+    strncpy(it->name, name, NAME_LEN - 1);
+    it->name[NAME_LEN - 1] = 0;
+    strncpy(it->file, file, NAME_LEN - 1);
+    it->file[NAME_LEN - 1] = 0;
+}
+
+void read_map(char * filename, map * m)
+{
+    char buf[512], line[1024], name[NAME_LEN], rest[NAME_LEN];
+    char pending[NAME_LEN + 2];
+    FILE *file;
+    unsigned long addr, size;
+    int n, started = 0;
+
+    if ((file = fopen(filename, "r")) == NULL) {
+        fprintf(stderr, "%s: failed to open\n", filename);
+        exit(1);
+    }
+
+    m->count = 0;
+    pending[0] = 0;
+    while (fgets(buf, sizeof(buf), file)) {
+        buf[strcspn(buf, "\r\n")] = 0;
+        if (!strncmp(buf, "Linker script and memory map", 28)) {
+            started = 1;
+            continue;
+        }
+        if (!started || buf[0] == 0)
+            continue;
+
+        /* Join a wrapped section name with its addresses; a section
+           without addresses has none on the next line */
+        if (pending[0] && sscanf(buf, " 0x%lx", &addr) == 1)
+            snprintf(line, sizeof(line), "%s%s", pending, buf);
+        else
+            snprintf(line, sizeof(line), "%s", buf);
+        pending[0] = 0;
+
+        rest[0] = 0;
+        if (line[0] != ' ') {
+            /* Output section */
+            n = sscanf(line, "%127s %lx %lx", name, &addr, &size);
+            if (n == 1 && name[0] == '.')
+                snprintf(pending, sizeof(pending), "%s ", name);
+            else if (n == 3 && name[0] == '.')
+                add_item(m, OUTPUT_SECTION, addr, size, name, "");
+            continue;
+        }
+
+        n = sscanf(line, " %127s %lx %lx %127s", name, &addr, &size, rest);
+        if (n == 1 && name[0] != '*' && strncmp(name, "0x", 2)) {
+            snprintf(pending, sizeof(pending), " %s ", name);
+            continue;
+        }
+        if (n >= 3 && !strcmp(name, "*fill*"))
+            add_item(m, FILL, addr, size, name, "");
+        else if (n >= 3 && name[0] == '.' && size > 0)
+            add_item(m, INPUT_SECTION, addr, size, name, rest);
+        /* A symbol is an address and a name, not a second number */
+        else if (!strncmp(name, "0x", 2) && !strchr(line, '=') &&
+                 sscanf(line, " %lx %127s", &addr, name) == 2 &&
+                 strncmp(name, "0x", 2))
+            add_item(m, SYMBOL, addr, 0, name, "");
+    }
+    fclose(file);
+}
+
+int by_item_addr(const void * a, const void * b)
+{
+    const item *x = *(item **)a, *y = *(item **)b;
+
+    /* Equal addresses in map order */
+    if (x->addr != y->addr)
+        return x->addr < y->addr ? -1 : 1;
+    return x < y ? -1 : x > y;
+}
+
+/* The symbols in [start, end) in address order into symbols, at most
+   max; of several at one address the first of the map. Returns the
+   number of symbols. */
+int map_symbols(map * m, long start, long end, item ** symbols, int max)
+{
+    int i, j, n = 0;
+
+    for (i = 0; i < m->count && n < max; i++)
+        if (m->items[i].type == SYMBOL &&
+            m->items[i].addr >= start && m->items[i].addr < end)
+            symbols[n++] = &m->items[i];
+    qsort(symbols, n, sizeof(item *), by_item_addr);
+
+    for (i = j = 0; i < n; i++)
+        if (j == 0 || symbols[j - 1]->addr != symbols[i]->addr)
+            symbols[j++] = symbols[i];
+    return j;
+}
+
+/* The output section name, NULL if the map has none */
+item * map_section(map * m, char * name)
+{
+    int i;
+
+    for (i = 0; i < m->count; i++)
+        if (m->items[i].type == OUTPUT_SECTION &&
+            !strcmp(m->items[i].name, name))
+            return &m->items[i];
+    return NULL;
+}
+
+#endif /* RCX_MAP_H */
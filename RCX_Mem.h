@@ -0,0 +1,91 @@
+/* RCX_Mem.h
+ *
+ * Block move and fill. GCC also calls memcpy and memset for structure
+ * copies and initializers, so programs that use those include this.
+ *
+ * memcpy moves up to 255 bytes per eepmov, 4 states per byte. No
+ * interrupt is accepted during an eepmov, which delays interrupts by
+ * up to 64 us. memset stores words with pre-decrement from the end of
+ * the block, unrolled 8 times, 3 states per byte and a few for the
+ * loop.
+ *
+ * eepmov needs r4, r5 and r6, so r6 must not be the frame pointer:
+ * compile with -fomit-frame-pointer, which -O implies.
+ */
+
+#ifndef RCX_MEM_H
+#define RCX_MEM_H
+
+#include <stddef.h>
+
+#include "RCX_RTE.h"
+
+/* Move count bytes, 0 < count < 256, with one eepmov */
+static inline void mem_eepmov (void *dst, const void *src, byte count)
+{
+  register void *d asm ("r6") = dst;
+  register const void *s asm ("r5") = src;
+  register uint16 c asm ("r4") = count;
+
+  asm volatile ("eepmov" : "+r" (d), "+r" (s), "+r" (c) : : "memory");
+}
+
+void *memcpy (void *dst, const void *src, size_t n)
+{
+  byte *d = dst;
+  const byte *s = src;
+
+  while (n > 255) {
+    mem_eepmov(d, s, 255);
+    d += 255;
+    s += 255;
+    n -= 255;
+  }
+  if (n)
+    mem_eepmov(d, s, n);
+  return dst;
+}
+
+/* memcpy copies forward, which is right when dst is below src */
+void *memmove (void *dst, const void *src, size_t n)
+{
+  byte *d = dst;
+  const byte *s = src;
+
+  if (d <= s || d >= s + n)
+    return memcpy(dst, src, n);
+
+  d += n;
+  s += n;
+  while (n--)
+    *--d = *--s;
+  return dst;
+}
+
+void *memset (void *dst, int c, size_t n)
+{
+  byte *end = (byte *)dst + n;
+  word *w;
+  word fill;
+  size_t k;
+
+  if (n && ((word)end & 1)) {
+    *--end = c;
+    n--;
+  }
+
+  fill = (byte)c << 8 | (byte)c;
+  w = (word *)end;
+
+  for (k = n >> 4; k; k--) {
+    *--w = fill; *--w = fill; *--w = fill; *--w = fill;
+    *--w = fill; *--w = fill; *--w = fill; *--w = fill;
+  }
+  for (k = (n >> 1) & 7; k; k--)
+    *--w = fill;
+  if (n & 1)
+    ((byte *)w)[-1] = c;
+  return dst;
+}
+
+#endif /* RCX_MEM_H */
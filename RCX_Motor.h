@@ -0,0 +1,114 @@
+/* RCX_Motor.h
+ *
+ * Outputs A, B and C. motor_set only records direction and power; the
+ * 1 ms tick of RCX_Time.h computes the pattern of all three outputs
+ * and writes it to the motor driver with one store. A change takes
+ * effect at the next tick.
+ *
+ * Power 0 to 255 is pulse density modulated per tick: each tick the
+ * power is added to an accumulator and the output is on when the sum
+ * carries. 255 is always on. Between pulses the output floats.
+ *
+ * motor_set also sets the direction arrows of the output in the LCD
+ * frame buffer of RCX_LCD.h, which the program shows with its next
+ * lcd_fb_flush. Call motor_set from tasks, not from interrupt
+ * handlers.
+ *
+ *   time_init();
+ *   motor_init();
+ *   motor_set(MOTOR_A, MOTOR_FWD, 192);
+ */
+
+#ifndef RCX_MOTOR_H
+#define RCX_MOTOR_H
+
+#include "RCX_Time.h"
+#include "RCX_LCD.h"
+
+#define MOTOR_A         0
+#define MOTOR_B         1
+#define MOTOR_C         2
+
+#define MOTOR_OFF       0               /* float                        */
+#define MOTOR_FWD       1
+#define MOTOR_REV       2
+#define MOTOR_BRAKE     3
+
+#define MOTOR_MAX       255
+
+/* Driver bits of each output by direction */
+const byte motor_pattern[3][4] = {
+  { 0x00, 0x80, 0x40, 0xc0 },           /* A                            */
+  { 0x00, 0x08, 0x04, 0x0c },           /* B                            */
+  { 0x00, 0x02, 0x01, 0x03 },           /* C                            */
+};
+
+/* pattern and power are read by motor_tick, sum only used by it */
+struct motor { volatile byte pattern;
+               volatile byte power;
+               byte sum;
+               byte dir;
+             };
+
+struct motor motor[3];
+vector motor_next_hook;
+
+/* Tick hook: one write to the motor driver for all outputs */
+void motor_tick (void)
+{
+  struct motor *m;
+  byte out, sum;
+
+  out = 0;
+  for (m = motor; m < &motor[3]; m++) {
+    sum = m->sum + m->power;
+    if (sum < m->sum || m->power == MOTOR_MAX)
+      out |= m->pattern;
+    m->sum = sum;
+  }
+  MOTOR = out;
+
+  if (motor_next_hook)
+    motor_next_hook();
+}
+
+/* Stop all outputs and start the driver. Needs time_init first. */
+void motor_init (void)
+{
+  byte n, ccr;
+
+  for (n = 0; n < 3; n++) {
+    motor[n].pattern = motor[n].power = motor[n].sum = 0;
+    motor[n].dir = MOTOR_OFF;
+  }
+
+  ccr = irq_save();
+  motor_next_hook = time_hook;
+  time_hook = motor_tick;
+  irq_restore(ccr);
+}
+
+/* Set direction and power of output n. Braking ignores the power. */
+void motor_set (byte n, byte dir, byte power)
+{
+  struct motor *m = &motor[n];
+  uint16 fwd = LCD_MOTOR_0_FWD + 3 * n;
+  uint16 rev = LCD_MOTOR_0_REV + 3 * n;
+
+  m->power = dir == MOTOR_BRAKE ? MOTOR_MAX : power;
+  m->pattern = motor_pattern[n][dir];
+
+  if (dir != m->dir) {
+    m->dir = dir;
+    if (dir == MOTOR_FWD)
+      lcd_fb_show_icon(fwd);
+    else
+      lcd_fb_hide_icon(fwd);
+    if (dir == MOTOR_REV)
+      lcd_fb_show_icon(rev);
+    else
+      lcd_fb_hide_icon(rev);
+  }
+}
+
+#endif /* RCX_MOTOR_H */
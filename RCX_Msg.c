@@ -0,0 +1,209 @@
+/*
+ *  RCX_Msg.c
+ *
+ *  Streams messages to a program that answers them with msg_command of
+ *  RCX_Msg.h, e.g. to steer a robot from a script. The port is opened
+ *  once and every packet is built before it is needed; each one goes
+ *  out as soon as the tower has echoed the one before, so without
+ *  replies the IR link is the only limit. rcx sends one message per
+ *  run and waits 0.1 s for a reply after each.
+ *
+ *  Under UNIX systems like IRIX, Linux, and Solaris, this program compiles
+ *  with gcc RCX_Msg.c -o rcxmsg.
+ *
+ *  Usage:
+ *
+ *     rcxmsg [-a] [-f] [message ...]
+ *
+ *  A message is hex bytes separated by commas, e.g. 1,ff,20. Without
+ *  messages on the command line, each line of the standard input is a
+ *  message, bytes separated by spaces or commas, sent as it is read.
+ *
+ *     -a   wait for the reply to each message and send it again if none
+ *          comes, up to 5 times.
+ *     -f   send one byte messages with the opcode 0xf7 of the standard
+ *          firmware, which has no reply and no sequence number.
+ *
+ *  Messages are numbered. Except with -f, rcxmsg asks the program
+ *  for its counters at the start and the end and prints how many
+ *  messages arrived, were lost or came twice.
+ *
+ *  The RS232 port connected to the infrared transmitter/receiver is
+ *  found as described in RCX_Tower.h. Set the RCX_IR environment
+ *  variable to the name of the port to skip discovery.
+ *------------------------------------------------------------------------
+ */
+
+#include <stdio.h>      /* printf, fgets                                 */
+#include <stdlib.h>     /* strtoul, exit                                 */
+#include <string.h>     /* strcmp                                        */
+#include <sys/time.h>   /* gettimeofday                                  */
+
+#include "RCX_IR.h"     /* IR_open, IR_frame, IR_send, IR_reply          */
+
+#define MSG_FIRMWARE   0xf7     /* requests of RCX_Msg.h                 */
+#define MSG_ACK        0x96
+#define MSG_NOACK      0xa6
+#define MSG_STAT       0x06
+#define MSG_MAX        30       /* SERIAL_PACKET_MAX - 2                 */
+#define MAX_MESSAGES   1024
+
+struct frame_t { byte m[3 + 2 * (MSG_MAX + 3)];
+                 int n;
+               };
+typedef struct frame_t frame;
+
+frame frames[MAX_MESSAGES];
+
+int  ack, firmware;
+byte seq;
+
+/* Parse the hex bytes of s into the packet f. Returns 0, or -1. */
+int parse(char * s, frame * f)
+{
+    byte req[2 + MSG_MAX];
+    unsigned long v;
+    char *end;
+    int n;
+
+    req[0] = firmware ? MSG_FIRMWARE : ack ? MSG_ACK : MSG_NOACK;
+    req[1] = seq;
+    n = firmware ? 1 : 2;
+    for (;;) {
+        while (*s == ' ' || *s == ',' || *s == '\t' || *s == '\n')
+            s++;
+        if (!*s)
+            break;
+        v = strtoul(s, &end, 16);
+        if (end == s || v > 0xff || n == (firmware ? 2 : 2 + MSG_MAX))
+            return -1;
+        req[n++] = v;
+        s = end;
+    }
+    if (n == (firmware ? 1 : 2))
+        return -1;
+    f->n = IR_frame(req, n, f->m);
+    seq++;
+    return 0;
+}
+
+/* Counters of the program: seq received lost duplicates. Bit 3 of
+   the opcode differs between calls, as in the helper of download. */
+int get_stat(int fd, int * counters)
+{
+    static int toggle = 0;
+    byte req[1], reply[IR_MAXSIZE];
+
+    toggle ^= 0x08;
+    req[0] = MSG_STAT | toggle;
+    if (IR_request(fd, req, 1, reply) != 8)
+        return -1;
+    counters[0] = reply[1];
+    counters[1] = reply[2] | reply[3] << 8;
+    counters[2] = reply[4] | reply[5] << 8;
+    counters[3] = reply[6] | reply[7] << 8;
+    return 0;
+}
+
+int sent, garbled, resent, unanswered;
+
+void send_frame(int fd, frame * f)
+{
+    byte reply[IR_MAXSIZE];
+    int tries;
+
+    for (tries = 0; tries < (ack ? IR_TRIES : 1); tries++) {
+        if (tries)
+            resent++;
+        if (IR_send(fd, f->m, f->n) < 0) {
+            garbled++;
+            continue;
+        }
+        if (!ack)
+            break;
+        if (IR_reply(fd, reply, 2) == 2 && reply[0] == (byte)~MSG_ACK &&
+            reply[1] == f->m[5])
+            break;
+    }
+    if (ack && tries == IR_TRIES)
+        unanswered++;
+    sent++;
+}
+
+int main(int argc, char * argv[])
+{
+    char line[512];
+    int before[4], after[4], received;
+    struct timeval start, end;
+    double ms;
+    int fd, count, i;
+
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+        if (!strcmp(argv[i], "-a"))
+            ack = 1;
+        else if (!strcmp(argv[i], "-f"))
+            firmware = 1;
+        else
+            break;
+    }
+    if ((i < argc && argv[i][0] == '-') || (ack && firmware)) {
+        printf("usage: %s [-a | -f] [message ...]\n", argv[0]);
+        exit(1);
+    }
+
+    fd = IR_open();
+
+    if (!firmware) {
+        if (get_stat(fd, before) < 0) {
+            printf("No answer from the program.\n");
+            exit(1);
+        }
+        seq = before[0] + 1;
+    }
+
+    /* Messages of the command line: all packets first, then the stream */
+    for (count = 0; i < argc; i++, count++)
+        if (count == MAX_MESSAGES || parse(argv[i], &frames[count]) < 0) {
+            printf("Bad message: %s\n", argv[i]);
+            exit(1);
+        }
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < count; i++)
+        send_frame(fd, &frames[i]);
+    if (count == 0)
+        while (fgets(line, sizeof(line), stdin)) {
+            if (parse(line, &frames[0]) < 0) {
+                fprintf(stderr, "Bad message: %s", line);
+                continue;
+            }
+            send_frame(fd, &frames[0]);
+        }
+    gettimeofday(&end, NULL);
+
+    ms = (end.tv_sec - start.tv_sec) * 1000.0 +
+         (end.tv_usec - start.tv_usec) / 1000.0;
+    printf("%d messages in %.0f ms, %.1f ms each", sent, ms,
+           sent ? ms / sent : 0.0);
+    if (garbled)
+        printf(", %d echoes garbled", garbled);
+    if (resent)
+        printf(", %d sent again", resent);
+    if (unanswered)
+        printf(", %d unanswered", unanswered);
+    printf("\n");
+
+    if (!firmware) {
+        if (get_stat(fd, after) < 0) {
+            printf("No answer from the program.\n");
+            exit(1);
+        }
+        received = (after[1] - before[1]) & 0xffff;
+        printf("program: %d received, %d lost, %d twice\n", received,
+               sent > received ? sent - received : 0,
+               (after[3] - before[3]) & 0xffff);
+    }
+    close(fd);
+
+    exit(0);
+}
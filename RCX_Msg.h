@@ -0,0 +1,118 @@
+/* RCX_Msg.h
+ *
+ * Messages from the host, sent by rcxmsg. A message is up to
+ * MSG_MAX bytes; the handler is called with each new message from the
+ * task that calls msg_command.
+ *
+ *   void steer (const byte *data, byte n) { ... }
+ *
+ *   void command_run (void)
+ *   { byte cmd[SERIAL_PACKET_MAX], n;
+ *
+ *     while ((n = serial_packet(cmd, sizeof(cmd))) != 0)
+ *       msg_command(cmd, n);
+ *   }
+ *
+ *   msg_init(steer);
+ *
+ * Requests, bit 3 of the opcode ignored but for 0xf7, 16-bit values
+ * low byte first:
+ *
+ *   0xf7 m              message m of the standard firmware, no reply
+ *   0x96 seq data...    message, reply 0x69 seq
+ *   0xa6 seq data...    message, no reply
+ *   0x06                counters, reply 0xf9 seq received(2) lost(2)
+ *                       duplicates(2)
+ *
+ * The host numbers the messages with seq, 0-255. A message with the
+ * seq of the last one is a repeat, sent again because the reply was
+ * lost: it is answered but not handed to the handler. A jump in seq
+ * counts the messages skipped as lost. Messages without reply are
+ * sent back to back, as fast as the IR link carries them, and the
+ * counters tell the host how many arrived.
+ */
+
+#ifndef RCX_MSG_H
+#define RCX_MSG_H
+
+#include "RCX_Serial.h"
+
+#define MSG_MAX         (SERIAL_PACKET_MAX - 2)
+
+#define MSG_FIRMWARE    0xf7
+#define MSG_ACK         0x96
+#define MSG_NOACK       0xa6
+#define MSG_STAT        0x06
+
+struct msg_stat { uint16 received;
+                  uint16 lost;
+                  uint16 duplicates;
+                  byte seq;             /* of the last message          */
+                  byte any;             /* seq is valid                 */
+                };
+
+struct msg_stat msg_stat;
+void (*msg_handler)(const byte *data, byte n);
+
+void msg_init (void (*handler)(const byte *data, byte n))
+{
+  msg_handler = handler;
+  msg_stat.received = msg_stat.lost = msg_stat.duplicates = 0;
+  msg_stat.any = 0;
+}
+
+/* Handle a message request. Returns 0 if cmd is not one. */
+byte msg_command (const byte *cmd, byte n)
+{
+  struct msg_stat *s = &msg_stat;
+  byte reply[8], seq;
+
+  if (cmd[0] == MSG_FIRMWARE) {
+    if (n >= 2) {
+      s->received++;
+      if (msg_handler)
+        msg_handler(&cmd[1], 1);
+    }
+    return 1;
+  }
+
+  switch (cmd[0] & ~0x08) {
+  case MSG_ACK:
+  case MSG_NOACK:
+    if (n < 2)
+      return 1;
+    seq = cmd[1];
+    if (s->any && seq == s->seq)
+      s->duplicates++;
+    else {
+      if (s->any)
+        s->lost += (byte)(seq - s->seq - 1);
+      s->seq = seq;
+      s->any = 1;
+      s->received++;
+      if (msg_handler)
+        msg_handler(&cmd[2], n - 2);
+    }
+    if ((cmd[0] & ~0x08) == MSG_ACK) {
+      reply[0] = ~cmd[0];
+      reply[1] = seq;
+      serial_send(reply, 2);
+    }
+    return 1;
+
+  case MSG_STAT:
+    reply[0] = ~cmd[0];
+    reply[1] = s->seq;
+    reply[2] = s->received;
+    reply[3] = s->received >> 8;
+    reply[4] = s->lost;
+    reply[5] = s->lost >> 8;
+    reply[6] = s->duplicates;
+    reply[7] = s->duplicates >> 8;
+    serial_send(reply, 8);
+    return 1;
+  }
+  return 0;
+}
+
+#endif /* RCX_MSG_H */
@@ -0,0 +1,195 @@
+/*
+ *  RCX_Prof.c
+ *
+ *  Host side of the statistical profiler of RCX_Prof.h. Starts and
+ *  stops sampling on the brick, uploads the histogram over IR and
+ *  prints a flat profile with the functions of the linker map.
+ *
+ *  Under UNIX systems like IRIX, Linux, and Solaris, this program compiles
+ *  with gcc RCX_Prof.c -o rcxprof.
+ *
+ *  Usage:
+ *
+ *     rcxprof start           clear the histogram and start sampling
+ *     rcxprof stop            stop sampling
+ *     rcxprof prog.map        upload and print the profile
+ *
+ *  The program must answer the requests with prof_command. A bucket
+ *  that holds the end of one function and the start of the next is
+ *  shared between them by the bytes of each in the bucket.
+ *
+ *  The RS232 port connected to the infrared transmitter/receiver is
+ *  found as described in RCX_Tower.h. Set the RCX_IR environment
+ *  variable to the name of the port to skip discovery.
+ *------------------------------------------------------------------------
+ */
+
+#include <stdio.h>      /* printf, fopen, fgets                          */
+#include <stdlib.h>     /* qsort, exit                                   */
+#include <string.h>     /* memset, strcmp                                */
+
+#include "RCX_IR.h"     /* IR_open, IR_request                           */
+#include "RCX_Map.h"    /* read_map, map_symbols                         */
+
+#define PROGRAM_START  0x8000
+#define PROF_START     0x56     /* requests of RCX_Prof.h                */
+#define PROF_STATE     0x66
+#define PROF_READ      0x76
+#define PROF_READ_MAX  12
+
+/*------------------------------------------------------------------------
+ * Functions of the .text section of the linker map
+ *------------------------------------------------------------------------
+ */
+struct symbol_t { long addr;
+                  char name[NAME_LEN];
+                  double samples;
+                };
+typedef struct symbol_t symbol;
+
+symbol symbols[MAX_ITEMS];
+int    symbol_count;
+long   text_start, text_end;
+
+int by_samples(const void * a, const void * b)
+{
+    const symbol *x = a, *y = b;
+
+    return x->samples < y->samples ? 1 : x->samples > y->samples ? -1 : 0;
+}
+
+void read_functions(char * filename)
+{
+    static map m;
+    static item *found[MAX_ITEMS];
+    item *text;
+    int i;
+
+    read_map(filename, &m);
+    if ((text = map_section(&m, ".text")) == NULL)
+        return;
+    text_start = text->addr;
+    text_end = text->addr + text->size;
+
+    symbol_count = map_symbols(&m, text_start, text_end, found, MAX_ITEMS);
+    for (i = 0; i < symbol_count; i++) {
+        symbols[i].addr = found[i]->addr;
+        strcpy(symbols[i].name, found[i]->name);
+        symbols[i].samples = 0;
+    }
+}
+
+/* Share count samples of the bucket [start, end) among the functions
+ * that overlap it. Bytes before the first function count as the first.
+ */
+double outside;
+
+void attribute(long start, long end, unsigned count)
+{
+    long from, to;
+    int i;
+
+    if (!count)
+        return;
+    if (symbol_count == 0 || end <= text_start || start >= text_end) {
+        outside += count;
+        return;
+    }
+    for (i = 0; i < symbol_count; i++) {
+        from = i == 0 ? text_start : symbols[i].addr;
+        to = i + 1 < symbol_count ? symbols[i + 1].addr : text_end;
+        if (from < start)
+            from = start;
+        if (to > end)
+            to = end;
+        if (from < to)
+            symbols[i].samples += (double)count * (to - from) / (end - start);
+    }
+    /* the part of the bucket outside .text */
+    if (start < text_start)
+        outside += (double)count * (text_start - start) / (end - start);
+    if (end > text_end)
+        outside += (double)count * (end - text_end) / (end - start);
+}
+
+int get16(byte * p)
+{
+    return p[0] | p[1] << 8;
+}
+
+int main(int argc, char * argv[])
+{
+    byte req[4], reply[IR_MAXSIZE];
+    unsigned long samples;
+    int fd, grain, buckets, step, rom, other, on, first, n, i;
+    double total;
+
+    if (argc != 2) {
+        printf("usage: %s start | stop | prog.map\n", argv[0]);
+        exit(1);
+    }
+
+    fd = IR_open();
+
+    if (!strcmp(argv[1], "start") || !strcmp(argv[1], "stop")) {
+        req[0] = PROF_START;
+        req[1] = !strcmp(argv[1], "start");
+        if (IR_request(fd, req, 2, reply) < 0) {
+            printf("No answer from the profiler.\n");
+            exit(1);
+        }
+        close(fd);
+        exit(0);
+    }
+
+    read_functions(argv[1]);
+
+    req[0] = PROF_STATE;
+    if (IR_request(fd, req, 1, reply) != 16) {
+        printf("No answer from the profiler.\n");
+        exit(1);
+    }
+    grain   = get16(&reply[1]);
+    buckets = get16(&reply[3]);
+    step    = get16(&reply[5]);
+    samples = get16(&reply[7]) | (unsigned long)get16(&reply[9]) << 16;
+    rom     = get16(&reply[11]);
+    other   = get16(&reply[13]);
+    on      = reply[15];
+
+    for (first = 0; first < buckets; first += PROF_READ_MAX) {
+        req[0] = PROF_READ | ((first / PROF_READ_MAX) & 1) << 3;
+        req[1] = first;
+        req[2] = first >> 8;
+        req[3] = PROF_READ_MAX;
+        if ((n = IR_request(fd, req, 4, reply)) < 1) {
+            printf("No answer from the profiler at bucket %d.\n", first);
+            exit(1);
+        }
+        for (i = 0; i < (n - 1) / 2; i++)
+            attribute(PROGRAM_START + (long)(first + i) * grain,
+                      PROGRAM_START + (long)(first + i + 1) * grain,
+                      get16(&reply[1 + 2*i]));
+    }
+    close(fd);
+
+    qsort(symbols, symbol_count, sizeof(symbol), by_samples);
+
+    printf("%lu samples, one per %d us%s\n", samples, 2 * step,
+           on ? ", still sampling" : "");
+    total = samples ? (double)samples : 1.0;
+    printf("%9s %6s  %s\n", "samples", "%", "function");
+    for (i = 0; i < symbol_count && symbols[i].samples >= 0.5; i++)
+        printf("%9.0f %6.2f  %s\n", symbols[i].samples,
+               100.0 * symbols[i].samples / total, symbols[i].name);
+    if (outside >= 0.5)
+        printf("%9.0f %6.2f  (outside .text)\n", outside,
+               100.0 * outside / total);
+    if (rom)
+        printf("%9d %6.2f  (ROM)\n", rom, 100.0 * rom / total);
+    if (other)
+        printf("%9d %6.2f  (above the window)\n", other,
+               100.0 * other / total);
+
+    exit(0);
+}
@@ -0,0 +1,250 @@
+/* RCX_Prof.h
+ *
+ * Statistical profiler. Compare match B of the free-running timer
+ * interrupts every PROF_STEP FRC counts and counts the interrupted PC
+ * in a histogram of PROF_GRAIN byte buckets over the program window
+ * from 0x8000. rcxprof uploads the histogram and names the buckets
+ * after the functions in the linker map.
+ *
+ *   void command_run (void)
+ *   { byte cmd[SERIAL_PACKET_MAX], n;
+ *
+ *     while ((n = serial_packet(cmd, sizeof(cmd))) != 0)
+ *       if (!prof_command(cmd, n))
+ *         ...
+ *   }
+ *
+ *   sched_init();
+ *   serial_init(task_create(command_run));
+ *   prof_init();
+ *   prof_start();                      or rcxprof start
+ *
+ * The timer is shared with RCX_Time.h: compare match A clears the FRC
+ * every ms, so OCRB is moved on by PROF_STEP modulo TIME_FRC_PER_MS
+ * after each sample. With the default step of 397 counts, 794 us, the
+ * samples drift against the tick and do not all land on the same
+ * line of a periodic task. A sample costs about 230 states with the
+ * interrupt, 2% of the CPU.
+ *
+ * PCs below 0x8000, in the ROM, count in prof_rom; PCs above the
+ * window in prof_other. A bucket stops at 65535. Interrupt handlers
+ * other than the ROM dispatcher are not sampled, as the CPU masks
+ * interrupts while they run.
+ *
+ * Requests, in the format of the helper of download -v, bit 3 of the
+ * opcode ignored, 16-bit values low byte first:
+ *
+ *   0x56 on                 start (clears) or stop      reply 0xa9
+ *   0x66                    state                       reply 0x99 ...
+ *   0x76 first(2) count     count buckets, count <= 12  reply 0x89 ...
+ *
+ * The state reply is grain(2) buckets(2) step(2) samples(4) rom(2)
+ * other(2) on.
+ */
+
+#ifndef RCX_PROF_H
+#define RCX_PROF_H
+
+#include "RCX_Time.h"
+#include "RCX_Serial.h"
+
+#ifndef PROF_SHIFT
+#define PROF_SHIFT    5                 /* 32 byte buckets              */
+#endif
+#ifndef PROF_LEN
+#define PROF_LEN      0x4c00            /* IMAGE_LEN of download        */
+#endif
+#ifndef PROF_STEP
+#define PROF_STEP     397               /* FRC counts between samples   */
+#endif
+
+#define PROF_GRAIN    (1 << PROF_SHIFT)
+#define PROF_BUCKETS  (PROF_LEN >> PROF_SHIFT)
+#define PROF_FRC_MS   500               /* TIME_FRC_PER_MS, for asm     */
+
+#define PROF_START    0x56
+#define PROF_STATE    0x66
+#define PROF_READ     0x76
+#define PROF_READ_MAX 12
+
+#define PROF_STR(x)   PROF_STR2(x)
+#define PROF_STR2(x)  #x
+
+uint16 prof_hist[PROF_BUCKETS];
+volatile uint32 prof_samples;
+volatile uint16 prof_rom, prof_other;
+uint16 prof_ocrb;                       /* next compare value           */
+byte prof_on;
+vector prof_old_ocib;
+
+/* Compare match B: set the next match, then count the PC that the
+ * interrupt saved above the ROM's return address, r6 and the CCR.
+ */
+void prof_handler (void);
+asm (".section .text\n\t"
+     ".align 1\n"
+     "_prof_handler:\n\t"
+     "bclr #2,@0xff91:8       ; OCFB\n\t"
+     "push r0\n\t"
+     "mov.w @_prof_ocrb,r6\n\t"
+     "mov.w #" PROF_STR(PROF_STEP) ",r0\n\t"
+     "add.w r0,r6\n\t"
+     "mov.w #" PROF_STR(PROF_FRC_MS) ",r0\n\t"
+     "cmp.w r0,r6\n\t"
+     "bcs 1f\n\t"
+     "sub.w r0,r6\n"
+     "1:\n\t"
+     "mov.w r6,@_prof_ocrb\n\t"
+     "bset #4,@0xff97:8       ; OCRS\n\t"
+     "mov.w r6,@0xff94:16     ; OCRB\n\t"
+     "bclr #4,@0xff97:8\n\t"
+     "mov.w @_prof_samples+2,r6\n\t"
+     "adds #1,r6\n\t"
+     "mov.w r6,@_prof_samples+2\n\t"
+     "bne 2f\n\t"
+     "mov.w @_prof_samples,r6\n\t"
+     "adds #1,r6\n\t"
+     "mov.w r6,@_prof_samples\n"
+     "2:\n\t"
+     "mov.w @(8,r7),r0        ; PC\n\t"
+     "bpl 3f\n\t"
+     "bclr #7,r0h\n\t"
+     ".rept " PROF_STR(PROF_SHIFT) " - 1\n\t"
+     "shlr r0h\n\t"
+     "rotxr r0l\n\t"
+     ".endr\n\t"
+     "bclr #0,r0l\n\t"
+     "mov.w #" PROF_STR(PROF_BUCKETS) " * 2,r6\n\t"
+     "cmp.w r6,r0\n\t"
+     "bcc 4f\n\t"
+     "mov.w #_prof_hist,r6\n\t"
+     "add.w r6,r0\n\t"
+     "bra 5f\n"
+     "3:\n\t"
+     "mov.w #_prof_rom,r0\n\t"
+     "bra 5f\n"
+     "4:\n\t"
+     "mov.w #_prof_other,r0\n"
+     "5:\n\t"
+     "mov.w @r0,r6\n\t"
+     "adds #1,r6\n\t"
+     "mov.w r6,r6\n\t"
+     "beq 6f\n\t"
+     "mov.w r6,@r0\n"
+     "6:\n\t"
+     "pop r0\n\t"
+     "rts");
+
+/* Install the handler. Needs time_init or sched_init first. */
+void prof_init (void)
+{
+  byte ccr;
+
+  ccr = irq_save();
+  T_IER &= ~TIER_OCIBE;
+  prof_old_ocib = ocib_vector;
+  ocib_vector = prof_handler;
+  prof_on = 0;
+  irq_restore(ccr);
+}
+
+/* Clear the histogram and start sampling */
+void prof_start (void)
+{
+  uint16 i;
+  byte ccr;
+
+  ccr = irq_save();
+  T_IER &= ~TIER_OCIBE;
+  for (i = 0; i < PROF_BUCKETS; i++)
+    prof_hist[i] = 0;
+  prof_samples = 0;
+  prof_rom = prof_other = 0;
+
+  prof_ocrb = PROF_STEP % PROF_FRC_MS;
+  T_OCR |= TOCR_OCRS;
+  T_OCRB = prof_ocrb;
+  T_OCR &= ~TOCR_OCRS;
+  T_CSR &= ~TCSR_OCFB;
+  T_IER |= TIER_OCIBE;
+  prof_on = 1;
+  irq_restore(ccr);
+}
+
+void prof_stop (void)
+{
+  T_IER &= ~TIER_OCIBE;
+  prof_on = 0;
+}
+
+/* Stop sampling and give compare match B back */
+void prof_shutdown (void)
+{
+  byte ccr;
+
+  ccr = irq_save();
+  prof_stop();
+  ocib_vector = prof_old_ocib;
+  irq_restore(ccr);
+}
+
+static inline byte *prof_put16 (byte *p, uint16 v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  return p + 2;
+}
+
+/* Answer a profiler request from the host. Returns 0 if cmd is not
+ * one, 1 if it was answered or the reply did not fit the transmit
+ * queue; the host asks again then.
+ */
+byte prof_command (const byte *cmd, byte n)
+{
+  byte reply[1 + 2 * PROF_READ_MAX], *p;
+  uint32 samples;
+  uint16 first;
+  byte count, i, ccr;
+
+  reply[0] = ~cmd[0];
+  p = &reply[1];
+
+  switch (cmd[0] & ~0x08) {
+  case PROF_START:
+    if (n >= 2 && cmd[1])
+      prof_start();
+    else
+      prof_stop();
+    break;
+  case PROF_STATE:
+    ccr = irq_save();
+    samples = prof_samples;
+    irq_restore(ccr);
+    p = prof_put16(p, PROF_GRAIN);
+    p = prof_put16(p, PROF_BUCKETS);
+    p = prof_put16(p, PROF_STEP);
+    p = prof_put16(p, samples);
+    p = prof_put16(p, samples >> 16);
+    p = prof_put16(p, prof_rom);
+    p = prof_put16(p, prof_other);
+    *p++ = prof_on;
+    break;
+  case PROF_READ:
+    if (n < 4)
+      return 1;
+    first = cmd[1] | cmd[2] << 8;
+    count = cmd[3];
+    if (count > PROF_READ_MAX)
+      count = PROF_READ_MAX;
+    for (i = 0; i < count && first + i < PROF_BUCKETS; i++)
+      p = prof_put16(p, prof_hist[first + i]);
+    break;
+  default:
+    return 0;
+  }
+
+  serial_send(reply, p - reply);
+  return 1;
+}
+
+#endif /* RCX_PROF_H */
@@ -1,9 +1,14 @@
+#ifndef RCX_RTE_H
+#define RCX_RTE_H
+
 /* H8/300 data types */
 
 typedef unsigned char      byte;
 typedef unsigned short int word;
 typedef short int          int16;
 typedef unsigned short int uint16;
+typedef long int           int32;
+typedef unsigned long int  uint32;
 
 
 
@@ -95,6 +100,7 @@ void lcd_show_digit(int16 r)
 
 /* RCX_Reset: 
  * Reset RCX through an indirect jump through the reset vector at address 0
+ * To start only the program again, see restart in RCX_Restart.h
  */
 void RCX_Reset(void)
 { 
@@ -102,3 +108,5 @@ void RCX_Reset(void)
 }
 
 char *RCX_string="Do you byte, when I knock?";
+
+#endif /* RCX_RTE_H */
@@ -8,9 +8,12 @@
  *  Under UNIX systems like IRIX, Linux, and Solaris, this program compiles
  *  with gcc RCX_Request_Reply.c -o RCX_Request_Reply.
  *
- *  Set DEFAULT_RCX_IR to the name of the RS232 port connected to the 
- *  infrared transmitter/receiver. Set the RCX_IR environment variable 
- *  to override DEFAULT_RCX_IR.
+ *  With -t the program instead receives the telemetry of a program
+ *  that uses RCX_Telem.h, see receive_telemetry.
+ *
+ *  The RS232 port connected to the infrared transmitter/receiver is
+ *  found as described in RCX_Tower.h. Set the RCX_IR environment
+ *  variable to the name of the port to skip discovery.
  *
  *  To obtained a detailed knowledge of the different protocol layers,
  *  insert calls to the routine print_sequence in the routine send_receive
@@ -40,6 +43,7 @@
 #include <termios.h>    /* termios, and related routines like tcsetattr 
                            and related constants like B2400.             */
 #include <string.h>     /* memset                                        */
+#include <sys/time.h>   /* gettimeofday                                  */
 
 /*------------------------------------------------------------------------ 
  * RCX infrared routines. 
@@ -51,10 +55,7 @@
  *------------------------------------------------------------------------
  */
 
-#define DEFAULT_RCX_IR   "/dev/term/a"    /* Solaris name of serial port */
-      
-/* Linux - COM1 port is /dev/ttyS0 */
-/* SGI port is          /dev/ttyd2 */
+#include "RCX_Tower.h"  /* RCX_tower_name: RCX_IR, cached or discovered port */
 
 int RCX_IR_open()
 {
@@ -62,8 +63,7 @@ int RCX_IR_open()
     char * RCX_IR_Name;
     struct termios ios;
 
-    RCX_IR_Name = getenv("RCX_IR");
-    if (RCX_IR_Name == NULL) RCX_IR_Name = DEFAULT_RCX_IR;
+    RCX_IR_Name = RCX_tower_name();
 
     fd = open(RCX_IR_Name, O_RDWR);
     if ( fd < 0) {
@@ -482,6 +482,217 @@ void print_result(reply rep)
     }
 }
 
+/*-----------------------------------------------------------------------
+ * Telemetry:
+ *
+ * A program that uses RCX_Telem.h sends frames of samples without
+ * being asked, one packet after the other. The end of a packet is
+ * not marked; it ends where the next header starts, or when nothing
+ * arrives for 0.1 s.
+ *
+ * receive_packet:    reads bytes until a whole packet has arrived and
+ *                    returns its bytes without header, complements
+ *                    and checksum.
+ * decode_frame:      prints the samples of a frame, one line each:
+ *                    the time in ms since the first sample, then the
+ *                    value of each channel.
+ * receive_telemetry: starts the telemetry, decodes the frames for a
+ *                    number of seconds and stops it again.
+ *-----------------------------------------------------------------------
+ */
+#define TELEM_START  0xb6
+#define TELEM_FRAME  0x49
+#define TELEM_TRIES  5
+
+enum { WAIT_55, WAIT_FF, WAIT_00, WAIT_BYTE, WAIT_COMPLEMENT };
+
+int  rx_state = WAIT_55;
+byte rx_last;
+
+/* Copy the bytes received to bs, check the checksum and remove it */
+int end_packet(bytesequence * rx, bytesequence * bs)
+{
+    byte sum;
+    int i;
+
+    *bs = *rx;
+    if (bs->bytecount < 2)
+        return 0;
+    for (i = 0, sum = 0; i < bs->bytecount - 1; i++)
+        sum += bs->data[i];
+    if (bs->data[i] != sum)
+        return 0;
+    bs->bytecount--;
+    return 1;
+}
+
+/* Returns 1 with a packet in bs, or 0 after 0.1 s of silence */
+int receive_packet(int fd, bytesequence * bs)
+{
+    static bytesequence rx;
+    byte c;
+    int count, done;
+
+    for (;;) {
+        if ((count = read(fd, &c, 1)) == -1) {
+            printf("Error in read.\n");
+            exit(1);
+        }
+        if (count == 0) {
+            done = rx_state >= WAIT_BYTE && end_packet(&rx, bs);
+            rx_state = WAIT_55;
+            if (done)
+                return 1;
+            return 0;
+        }
+        switch (rx_state) {
+        case WAIT_55:
+            if (c == 0x55)
+                rx_state = WAIT_FF;
+            break;
+        case WAIT_FF:
+            rx_state = c == 0xff ? WAIT_00 : WAIT_55;
+            break;
+        case WAIT_00:
+            rx_state = c == 0x00 ? WAIT_BYTE : WAIT_55;
+            rx.bytecount = 0;
+            break;
+        case WAIT_BYTE:
+            rx_last = c;
+            rx_state = WAIT_COMPLEMENT;
+            break;
+        case WAIT_COMPLEMENT:
+            if (c == (byte)~rx_last && rx.bytecount < MAXSIZE) {
+                rx.data[rx.bytecount++] = rx_last;
+                rx_state = WAIT_BYTE;
+            } else if (rx_last == 0x55 && c == 0xff) {
+                /* The header of the next packet */
+                done = end_packet(&rx, bs);
+                rx_state = WAIT_00;
+                if (done)
+                    return 1;
+            } else
+                rx_state = WAIT_55;
+            break;
+        }
+    }
+}
+
+/* Read a varint at *i of bs. Returns -1 if the frame ends first. */
+long read_varint(bytesequence * bs, int * i)
+{
+    long v = 0;
+    int shift = 0;
+
+    while (*i < bs->bytecount && shift < 21) {
+        v |= (long)(bs->data[*i] & 0x7f) << shift;
+        shift += 7;
+        if (!(bs->data[(*i)++] & 0x80))
+            return v;
+    }
+    return -1;
+}
+
+unsigned long telem_now;        /* ms, from the 16 bit time of the brick */
+unsigned long telem_origin;
+int           telem_samples;
+int           telem_frames;
+int           telem_lost;
+int           telem_seq = -1;
+
+void decode_frame(bytesequence * bs)
+{
+    unsigned short time, value[256];
+    long t, d;
+    int channels, i, j;
+
+    channels = bs->data[2];
+    if (telem_seq >= 0)
+        telem_lost += (byte)(bs->data[1] - telem_seq - 1);
+    telem_seq = bs->data[1];
+    telem_frames++;
+
+    /* The first record is the keyframe, against time 0 and values 0 */
+    time = 0;
+    memset(value, 0, sizeof(value));
+    for (i = 3; i < bs->bytecount; ) {
+        if ((t = read_varint(bs, &i)) < 0)
+            return;
+        time += t;
+        for (j = 0; j < channels; j++) {
+            if ((d = read_varint(bs, &i)) < 0)
+                return;
+            value[j] += (d & 1) ? ~(d >> 1) : d >> 1;
+        }
+        if (telem_samples++ == 0)
+            telem_now = telem_origin = time;
+        else
+            telem_now += (unsigned short)(time - telem_now);
+        printf("%8lu", telem_now - telem_origin);
+        for (j = 0; j < channels; j++)
+            printf(" %6d", (short)value[j]);
+        printf("\n");
+    }
+}
+
+void send_telemetry_request(int fd, int on)
+{
+    request req;
+
+    req.data[0] = TELEM_START;
+    req.data[1] = on;
+    req.bytecount = 2;
+    send_IR_packet(fd, build_IR_packet(build_packet(req)));
+}
+
+void receive_telemetry(int seconds)
+{
+    struct timeval start, now;
+    bytesequence bs;
+    int fd, tries, stopped;
+
+    fd = RCX_IR_open();
+
+    gettimeofday(&start, NULL);
+    tries = 0;
+    send_telemetry_request(fd, 1);
+    do {
+        if (receive_packet(fd, &bs)) {
+            if (bs.bytecount > 3 && bs.data[0] == TELEM_FRAME) {
+                decode_frame(&bs);
+                fflush(stdout);
+            }
+        } else if (telem_frames == 0 && ++tries % 10 == 0) {
+            /* Nothing for a second: ask again */
+            if (tries / 10 == TELEM_TRIES) {
+                printf("No telemetry.\n");
+                exit(1);
+            }
+            send_telemetry_request(fd, 1);
+        }
+        gettimeofday(&now, NULL);
+    } while (now.tv_sec - start.tv_sec < seconds);
+
+    /* The brick does not listen while it sends: ask until it answers */
+    stopped = 0;
+    for (tries = 0; tries < TELEM_TRIES && !stopped; tries++) {
+        send_telemetry_request(fd, 0);
+        while (receive_packet(fd, &bs))
+            if (bs.bytecount == 1 && bs.data[0] == TELEM_FRAME)
+                stopped = 1;
+            else if (bs.bytecount > 3 && bs.data[0] == TELEM_FRAME)
+                decode_frame(&bs);
+    }
+
+    RCX_IR_close(fd);
+
+    fprintf(stderr, "%d samples in %d frames, %d frames lost, "
+            "%.1f samples/s%s\n", telem_samples, telem_frames, telem_lost,
+            telem_now > telem_origin ?
+                1000.0 * (telem_samples - 1) / (telem_now - telem_origin) : 0,
+            stopped ? "" : ", not stopped");
+}
+
 
 int main (int argc, char * argv[]) {
 
@@ -491,9 +702,16 @@ int main (int argc, char * argv[]) {
     /* Print usage if no arguments. */
     if (argc == 1) {
 	printf("usage: %s byte [byte ...]\n", argv[0]);
+	printf("       %s -t [seconds]\n", argv[0]);
 	exit(1);
     }
 
+    /* Receive telemetry, 10 seconds by default. */
+    if (!strcmp(argv[1], "-t")) {
+	receive_telemetry(argc > 2 ? atoi(argv[2]) : 10);
+	exit(0);
+    }
+
     /* Assemble request for the RCX Executive from the program arguments. */
     req = assemble_request(argc,argv);
 
@@ -0,0 +1,97 @@
+/* RCX_Restart.h
+ *
+ * Warm restart: the program starts again from main as it was
+ * downloaded, in a few ms, without the reset of RCX_Reset, after which
+ * the ROM starts over and the program must be downloaded again.
+ * restart puts the hardware back as the ROM left it, which undoes all
+ * drivers, see RCX_Boot.h, and jumps to __restart of crt0.s, which
+ * puts back .data from the copy taken at the cold start and clears
+ * .bss. The image in RAM and the state of the ROM stay as they are.
+ *
+ *   restart_init();                    first thing in main
+ *   sched_init();
+ *   serial_init(task_create(command_run));
+ *   restart_watch(BUTTON_VIEW);        restart when View is pressed
+ *
+ * A command task that passes requests to restart_command lets the
+ * host restart the program, e.g. with rcx 16:
+ *
+ *   0x16            restart, reply 0xe9 before it
+ *
+ * Variables with RESTART_NOINIT keep their values across a warm
+ * restart and are 0 after the download; restart_count counts the
+ * warm restarts.
+ */
+
+#ifndef RCX_RESTART_H
+#define RCX_RESTART_H
+
+#include "RCX_Boot.h"
+#include "RCX_Serial.h"
+
+#define RESTART_NOINIT  __attribute__ ((section (".noinit")))
+
+#define RESTART_REQUEST 0x16
+#define RESTART_POLL_MS 20
+
+struct boot restart_boot RESTART_NOINIT;
+byte restart_saved RESTART_NOINIT;
+uint16 restart_count RESTART_NOINIT;
+
+byte restart_button, restart_down;
+
+/* Keep the state of the ROM at the cold start, before any driver */
+void restart_init (void)
+{
+  if (!restart_saved) {
+    boot_save(&restart_boot);
+    restart_saved = 1;
+  } else
+    restart_count++;
+}
+
+/* Start the program again. Does not return. */
+void restart (void)
+{
+  irq_disable();
+  boot_restore(&restart_boot);
+  asm volatile ("andc #0x7f,ccr\n\t"
+                "jmp @__restart");
+  for (;;)
+    ;
+}
+
+void restart_poll (void)
+{
+  byte down = button_state() & restart_button;
+
+  if (down && !restart_down)
+    restart();
+  restart_down = down;
+}
+
+/* Restart when button, BUTTON_ bits of RCX_H8.h, is pressed. Needs
+ * sched_init first.
+ */
+void restart_watch (byte button)
+{
+  restart_button = button;
+  restart_down = button_state() & button;
+  task_every(task_create(restart_poll), RESTART_POLL_MS);
+}
+
+/* Answer a restart request, then restart. Returns 0 if cmd is not one. */
+byte restart_command (const byte *cmd, byte n)
+{
+  byte reply[1];
+
+  if ((cmd[0] & ~0x08) != RESTART_REQUEST)
+    return 0;
+  reply[0] = ~cmd[0];
+  serial_send(reply, 1);
+  serial_drain(500);                    /* before the port is reset     */
+  restart();
+  return 1;
+}
+
+#endif /* RCX_RESTART_H */
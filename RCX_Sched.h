@@ -0,0 +1,168 @@
+/* RCX_Sched.h
+ *
+ * Cooperative scheduler on the 1 ms clock of RCX_Time.h. A task is a
+ * function that does a bit of work and returns; it keeps its state in
+ * static variables between runs. A task runs when its timer expires,
+ * periodically or once, or when an interrupt handler wakes it. When
+ * no task is ready the CPU sleeps until the next interrupt instead of
+ * spinning in a wait loop.
+ *
+ *   static task_id blink;
+ *
+ *   void blink_run (void) { ... }
+ *
+ *   sched_init();
+ *   blink = task_create(blink_run);
+ *   task_every(blink, 500);
+ *   sched_run();
+ *
+ * All tasks run on the one stack, so a task that does not return
+ * stops all others.
+ */
+
+#ifndef RCX_SCHED_H
+#define RCX_SCHED_H
+
+#include "RCX_Time.h"
+
+#define SCHED_TASKS     8               /* max number of tasks          */
+
+typedef byte task_id;
+
+#define TASK_NONE       0xff
+
+#define TASK_PERIODIC   0x01            /* timer restarts on expiry     */
+#define TASK_ONCE       0x02            /* timer stops on expiry        */
+
+/* due is the tick at which the timer expires next. ready is set by
+ * task_wake and the timer and cleared just before the task runs, so a
+ * wake-up during a run makes the task run again.
+ */
+struct task { void (*run)(void);
+              uint16 period;
+              uint16 due;
+              byte timer;
+              volatile byte ready;
+            };
+
+struct task sched_task[SCHED_TASKS];
+byte sched_tasks;
+
+volatile byte sched_pending;            /* a task was woken             */
+
+/* Start the clock. Any tasks created before are removed. */
+void sched_init (void)
+{
+  sched_tasks = 0;
+  sched_pending = 0;
+  time_init();
+}
+
+/* Stop the clock and give the timer back to the ROM */
+void sched_shutdown (void)
+{
+  time_shutdown();
+}
+
+/* Add a task. Returns TASK_NONE if all SCHED_TASKS are in use. The
+ * task does not run until it is woken or its timer is set.
+ */
+task_id task_create (void (*run)(void))
+{
+  struct task *t;
+
+  if (sched_tasks == SCHED_TASKS)
+    return TASK_NONE;
+
+  t = &sched_task[sched_tasks];
+  t->run = run;
+  t->timer = 0;
+  t->ready = 0;
+  return sched_tasks++;
+}
+
+/* Run task id every ms milliseconds, the first time ms from now.
+ * The period does not drift when runs are late. ms 0 stops the timer.
+ */
+void task_every (task_id id, uint16 ms)
+{
+  struct task *t = &sched_task[id];
+
+  t->period = ms;
+  t->due = time_ticks() + ms;
+  t->timer = ms ? TASK_PERIODIC : 0;
+}
+
+/* Run task id once, ms milliseconds from now */
+void task_after (task_id id, uint16 ms)
+{
+  struct task *t = &sched_task[id];
+
+  t->due = time_ticks() + ms;
+  t->timer = TASK_ONCE;
+}
+
+/* Run task id at the next pass of the scheduler. May be called from
+ * interrupt handlers.
+ */
+void task_wake (task_id id)
+{
+  sched_task[id].ready = 1;
+  sched_pending = 1;
+}
+
+/* One pass: run the tasks that are ready or whose timer expired, in
+ * the order they were created. Returns 0 if no task ran.
+ */
+byte sched_poll (void)
+{
+  struct task *t;
+  uint16 now;
+  byte i, ran;
+
+  sched_pending = 0;
+  now = time_ticks();
+  ran = 0;
+
+  for (i = 0, t = sched_task; i < sched_tasks; i++, t++) {
+    if (t->timer && (int16)(now - t->due) >= 0) {
+      if (t->timer == TASK_ONCE)
+        t->timer = 0;
+      else
+        /* skip the periods missed by a long run of another task */
+        do
+          t->due += t->period;
+        while ((int16)(now - t->due) >= 0);
+      t->ready = 1;
+    }
+    if (t->ready) {
+      t->ready = 0;
+      t->run();
+      ran = 1;
+    }
+  }
+
+  return ran;
+}
+
+/* Sleep until the next interrupt unless a task was woken since the
+ * last pass. The tick ends the sleep after at most 1 ms.
+ */
+void sched_idle (void)
+{
+  irq_disable();
+  if (sched_pending)
+    irq_enable();
+  else
+    irq_enable_sleep();
+}
+
+/* Run the tasks forever */
+void sched_run (void)
+{
+  for (;;)
+    if (!sched_poll())
+      sched_idle();
+}
+
+#endif /* RCX_SCHED_H */
@@ -0,0 +1,182 @@
+/* RCX_Sensor.h
+ *
+ * Inputs 1, 2 and 3, here sensors 0, 1 and 2, read as raw values
+ * 0-1023. The 1 ms tick of RCX_Time.h starts one scan of the A/D
+ * channels; the conversion end interrupt stores each sensor's value
+ * in its ring of SENSOR_SAMPLES, keeps a running sum for the average
+ * and wakes a task. A loop from sensor to motor can so react within
+ * about 2 ms. sensor_read applies the filter chosen for the sensor:
+ *
+ *   SENSOR_RAW       the last sample
+ *   SENSOR_AVERAGE   mean of the last SENSOR_SAMPLES samples
+ *   SENSOR_MEDIAN    median of the last 5 samples, against spikes
+ *
+ * sensor_on and sensor_off also set the sensor icon in the LCD frame
+ * buffer of RCX_LCD.h, which the program shows with its next
+ * lcd_fb_flush. Active sensors, which need power from the input, are
+ * not supported.
+ */
+
+#ifndef RCX_SENSOR_H
+#define RCX_SENSOR_H
+
+#include "RCX_Sched.h"
+#include "RCX_LCD.h"
+
+#define SENSOR_SAMPLES  8               /* power of 2, sum fits 16 bit  */
+
+#define SENSOR_RAW      0
+#define SENSOR_AVERAGE  1
+#define SENSOR_MEDIAN   2
+
+struct sensor { volatile uint16 sample[SENSOR_SAMPLES];
+                volatile uint16 sum;
+                byte on;
+                byte filter;
+              };
+
+struct sensor sensor[3];
+volatile byte sensor_head;              /* next sample, all sensors     */
+volatile uint16 sensor_time;            /* time_ticks() of last sample  */
+task_id sensor_task = TASK_NONE;
+byte sensor_started;
+vector sensor_next_hook;
+vector sensor_old_adi;
+
+/* A/D result register of each sensor */
+volatile word * const sensor_ad[3] = { &AD_C, &AD_B, &AD_A };
+
+/* Tick hook: scan AN0-AN3 once */
+void sensor_tick (void)
+{
+  if (sensor[0].on | sensor[1].on | sensor[2].on)
+    AD_CSR = ADCSR_ADIE | ADCSR_ADST | ADCSR_SCAN | 3;
+
+  if (sensor_next_hook)
+    sensor_next_hook();
+}
+
+/* Conversion end: stop the scan and store the samples */
+void sensor_adi (void)
+{
+  struct sensor *s;
+  uint16 v;
+  byte n, head;
+
+  AD_CSR &= ~(ADCSR_ADF | ADCSR_ADIE | ADCSR_ADST);
+
+  head = sensor_head;
+  for (n = 0, s = sensor; n < 3; n++, s++)
+    if (s->on) {
+      v = *sensor_ad[n] >> 6;
+      s->sum += v - s->sample[head];
+      s->sample[head] = v;
+    }
+  sensor_head = (head + 1) & (SENSOR_SAMPLES - 1);
+  sensor_time = time_ticks();
+
+  if (sensor_task != TASK_NONE)
+    task_wake(sensor_task);
+}
+
+RCX_HANDLER(sensor_adi_handler, sensor_adi);
+
+/* Start sampling. task is woken after each scan, or TASK_NONE. Needs
+ * time_init or sched_init first.
+ */
+void sensor_init (task_id task)
+{
+  byte ccr;
+
+  sensor_task = task;
+  if (sensor_started)
+    return;
+  sensor_started = 1;
+
+  ccr = irq_save();
+  sensor_old_adi = adi_vector;
+  adi_vector = sensor_adi_handler;
+  sensor_next_hook = time_hook;
+  time_hook = sensor_tick;
+  irq_restore(ccr);
+}
+
+/* Sample sensor n. Its ring starts filled with the current value. */
+void sensor_on (byte n, byte filter)
+{
+  struct sensor *s = &sensor[n];
+  uint16 v;
+  byte i;
+
+  if (!sensor_started)
+    sensor_init(sensor_task);
+
+  s->on = 0;
+  v = *sensor_ad[n] >> 6;
+  for (i = 0; i < SENSOR_SAMPLES; i++)
+    s->sample[i] = v;
+  s->sum = v * SENSOR_SAMPLES;
+  s->filter = filter;
+  s->on = 1;
+
+  lcd_fb_show_icon(LCD_SENSOR_0_ACTIVE + 2 * n);
+}
+
+void sensor_off (byte n)
+{
+  sensor[n].on = 0;
+  lcd_fb_hide_icon(LCD_SENSOR_0_ACTIVE + 2 * n);
+}
+
+/* Last sample */
+static inline uint16 sensor_raw (byte n)
+{
+  return sensor[n].sample[(sensor_head - 1) & (SENSOR_SAMPLES - 1)];
+}
+
+static inline uint16 sensor_average (byte n)
+{
+  return sensor[n].sum / SENSOR_SAMPLES;
+}
+
+#define SENSOR_SWAP(a, b) \
+  if (a > b) { t = a; a = b; b = t; }
+
+uint16 sensor_median (byte n)
+{
+  struct sensor *s = &sensor[n];
+  uint16 a, b, c, d, e, t;
+  byte head, ccr;
+
+  ccr = irq_save();
+  head = sensor_head;
+  a = s->sample[(head - 1) & (SENSOR_SAMPLES - 1)];
+  b = s->sample[(head - 2) & (SENSOR_SAMPLES - 1)];
+  c = s->sample[(head - 3) & (SENSOR_SAMPLES - 1)];
+  d = s->sample[(head - 4) & (SENSOR_SAMPLES - 1)];
+  e = s->sample[(head - 5) & (SENSOR_SAMPLES - 1)];
+  irq_restore(ccr);
+
+  /* 7 compares give the median of 5 */
+  SENSOR_SWAP(a, b);
+  SENSOR_SWAP(d, e);
+  SENSOR_SWAP(a, d);
+  SENSOR_SWAP(b, e);
+  SENSOR_SWAP(b, c);
+  SENSOR_SWAP(c, d);
+  SENSOR_SWAP(b, c);
+  return c;
+}
+
+#undef SENSOR_SWAP
+
+uint16 sensor_read (byte n)
+{
+  switch (sensor[n].filter) {
+  case SENSOR_AVERAGE: return sensor_average(n);
+  case SENSOR_MEDIAN:  return sensor_median(n);
+  default:             return sensor_raw(n);
+  }
+}
+
+#endif /* RCX_SENSOR_H */
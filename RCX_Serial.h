@@ -0,0 +1,322 @@
+/* RCX_Serial.h
+ *
+ * Interrupt driven driver for the serial interface of the IR port.
+ * The receive interrupt puts each byte into a ring buffer and wakes a
+ * task of RCX_Sched.h; the task takes whole packets out with
+ * serial_packet. serial_send queues a packet and returns at once, the
+ * transmit interrupt sends it.
+ *
+ * Packets have the format of the ROM and of build_IR_packet in
+ * RCX_Request_Reply.c: 0x55 0xff 0x00, each byte followed by its
+ * complement, and the sum of the bytes as the last pair. A packet ends
+ * where the next header starts or after SERIAL_GAP_MS of silence, as
+ * the host tools end a reply. serial_packet sets a one-shot timer on
+ * the serial task to notice the silence, so that task should have no
+ * timer of its own.
+ *
+ * The ring buffers have one writer and one reader each, an interrupt
+ * handler and the program, and need no locks. The baud rate and
+ * parity are left as set by the ROM, 2400 bit/s with odd parity.
+ *
+ *   void command_run (void)
+ *   { byte cmd[SERIAL_PACKET_MAX], n;
+ *
+ *     while ((n = serial_packet(cmd, sizeof(cmd))) != 0)
+ *       ...
+ *   }
+ *
+ *   sched_init();
+ *   serial_init(task_create(command_run));
+ */
+
+#ifndef RCX_SERIAL_H
+#define RCX_SERIAL_H
+
+#include "RCX_Sched.h"
+
+#define SERIAL_RX_SIZE     64           /* power of 2                   */
+#define SERIAL_TX_SIZE     64           /* power of 2                   */
+#define SERIAL_PACKET_MAX  32           /* bytes without complements    */
+#define SERIAL_GAP_MS      10           /* a byte takes 4.6 ms          */
+
+byte serial_rx_buf[SERIAL_RX_SIZE];
+volatile byte serial_rx_head;           /* written by serial_rxi        */
+volatile byte serial_rx_tail;           /* written by the program       */
+volatile uint16 serial_rx_time;         /* time_ticks() of last byte    */
+volatile byte serial_rx_lost;           /* overruns and bad bytes       */
+
+byte serial_tx_buf[SERIAL_TX_SIZE];
+volatile byte serial_tx_head;           /* written by the program       */
+volatile byte serial_tx_tail;           /* written by serial_txi        */
+
+task_id serial_task;
+
+vector serial_old_rxi, serial_old_eri, serial_old_txi, serial_old_tei;
+
+/* Receiver of serial_packet */
+#define SERIAL_HDR0   0                 /* waiting for 0x55             */
+#define SERIAL_HDR1   1                 /* waiting for 0xff             */
+#define SERIAL_HDR2   2                 /* waiting for 0x00             */
+#define SERIAL_BYTE   3                 /* waiting for a byte           */
+#define SERIAL_COMP   4                 /* waiting for its complement   */
+
+struct serial_rx { byte state;
+                   byte last;
+                   byte count;
+                   byte data[SERIAL_PACKET_MAX];
+                 };
+
+struct serial_rx serial_rx;
+
+/* Interrupt handlers */
+void serial_rxi (void)
+{
+  byte c, head, next;
+
+  c = S_RDR;
+  S_SR &= ~SSR_RDRF;
+
+  head = serial_rx_head;
+  next = (head + 1) & (SERIAL_RX_SIZE - 1);
+  if (next != serial_rx_tail) {
+    serial_rx_buf[head] = c;
+    serial_rx_head = next;
+  } else
+    serial_rx_lost++;
+  serial_rx_time = time_ticks();
+
+  if (serial_task != TASK_NONE)
+    task_wake(serial_task);
+}
+
+void serial_eri (void)
+{
+  S_SR &= ~(SSR_ORER | SSR_FER | SSR_PER);
+  serial_rx_lost++;
+}
+
+void serial_txi (void)
+{
+  byte tail = serial_tx_tail;
+
+  if (tail != serial_tx_head) {
+    S_TDR = serial_tx_buf[tail];
+    S_SR &= ~SSR_TDRE;
+    serial_tx_tail = (tail + 1) & (SERIAL_TX_SIZE - 1);
+  } else
+    /* queue empty, wait for the last bit to leave */
+    S_CR = (S_CR & ~SCR_TIE) | SCR_TEIE;
+}
+
+/* The receiver is off while sending, so the RCX does not hear itself */
+void serial_tei (void)
+{
+  S_CR = (S_CR & ~SCR_TEIE) | SCR_RE;
+}
+
+RCX_HANDLER(serial_rxi_handler, serial_rxi);
+RCX_HANDLER(serial_eri_handler, serial_eri);
+RCX_HANDLER(serial_txi_handler, serial_txi);
+RCX_HANDLER(serial_tei_handler, serial_tei);
+
+/* Take the serial interface over from the ROM. task is woken for each
+ * byte received, or TASK_NONE.
+ */
+void serial_init (task_id task)
+{
+  byte ccr;
+
+  ccr = irq_save();
+
+  serial_rx_head = serial_rx_tail = 0;
+  serial_tx_head = serial_tx_tail = 0;
+  serial_rx_lost = 0;
+  serial_rx.state = SERIAL_HDR0;
+  serial_task = task;
+
+  serial_old_rxi = rxi_vector;
+  serial_old_eri = eri_vector;
+  serial_old_txi = txi_vector;
+  serial_old_tei = tei_vector;
+  rxi_vector = serial_rxi_handler;
+  eri_vector = serial_eri_handler;
+  txi_vector = serial_txi_handler;
+  tei_vector = serial_tei_handler;
+
+  S_SR &= ~(SSR_RDRF | SSR_ORER | SSR_FER | SSR_PER);
+  S_CR = (S_CR & ~(SCR_TIE | SCR_TEIE)) | SCR_RIE | SCR_TE | SCR_RE;
+
+  irq_restore(ccr);
+}
+
+/* Give the serial interface back to the ROM. Bytes still queued for
+ * sending are dropped.
+ */
+void serial_shutdown (void)
+{
+  byte ccr;
+
+  ccr = irq_save();
+  S_CR = (S_CR & ~(SCR_TIE | SCR_TEIE)) | SCR_RE;
+  rxi_vector = serial_old_rxi;
+  eri_vector = serial_old_eri;
+  txi_vector = serial_old_txi;
+  tei_vector = serial_old_tei;
+  irq_restore(ccr);
+}
+
+/* Next received byte in c. Returns 0 if there is none. */
+byte serial_getc (byte *c)
+{
+  byte tail = serial_rx_tail;
+
+  if (tail == serial_rx_head)
+    return 0;
+  *c = serial_rx_buf[tail];
+  serial_rx_tail = (tail + 1) & (SERIAL_RX_SIZE - 1);
+  return 1;
+}
+
+/* Copy the received packet without the checksum to data, at most
+ * size bytes. Returns its length, or 0 if the packet was damaged.
+ */
+byte serial_packet_end (byte *data, byte size)
+{
+  struct serial_rx *rx = &serial_rx;
+  byte i, sum;
+
+  if (rx->count < 2)
+    return 0;
+
+  sum = 0;
+  for (i = 0; i < rx->count - 1; i++)
+    sum += rx->data[i];
+  if (sum != rx->data[rx->count - 1])
+    return 0;
+
+  for (i = 0; i < rx->count - 1 && i < size; i++)
+    data[i] = rx->data[i];
+  return i;
+}
+
+/* Take the next complete packet from the receive buffer. Returns the
+ * number of bytes copied to data, at most size, or 0 if no complete
+ * packet has arrived. Damaged packets are skipped. If a packet is
+ * still arriving, the serial task is run again after SERIAL_GAP_MS to
+ * end it, so the last packet of a burst is not left waiting.
+ */
+byte serial_packet (byte *data, byte size)
+{
+  struct serial_rx *rx = &serial_rx;
+  byte c, n;
+
+  while (serial_getc(&c))
+    switch (rx->state) {
+    case SERIAL_HDR0:
+      if (c == 0x55)
+        rx->state = SERIAL_HDR1;
+      break;
+    case SERIAL_HDR1:
+      if (c != 0x55)
+        rx->state = c == 0xff ? SERIAL_HDR2 : SERIAL_HDR0;
+      break;
+    case SERIAL_HDR2:
+      rx->state = c == 0x00 ? SERIAL_BYTE : SERIAL_HDR0;
+      rx->count = 0;
+      break;
+    case SERIAL_BYTE:
+      rx->last = c;
+      rx->state = SERIAL_COMP;
+      break;
+    case SERIAL_COMP:
+      if (c == (byte)~rx->last && rx->count < SERIAL_PACKET_MAX) {
+        rx->data[rx->count++] = rx->last;
+        rx->state = SERIAL_BYTE;
+      } else if (rx->last == 0x55 && c == 0xff) {
+        /* 0x55 is followed by 0xaa in a packet: a new header */
+        rx->state = SERIAL_HDR2;
+        if ((n = serial_packet_end(data, size)) != 0)
+          return n;
+      } else
+        rx->state = c == 0x55 ? SERIAL_HDR1 : SERIAL_HDR0;
+      break;
+    }
+
+  if (rx->state != SERIAL_BYTE)
+    return 0;
+
+  if ((int16)(time_ticks() - serial_rx_time) < SERIAL_GAP_MS) {
+    if (serial_task != TASK_NONE)
+      task_after(serial_task, SERIAL_GAP_MS);
+    return 0;
+  }
+
+  rx->state = SERIAL_HDR0;
+  return serial_packet_end(data, size);
+}
+
+/* Free space in the transmit queue */
+byte serial_tx_free (void)
+{
+  return (serial_tx_tail - serial_tx_head - 1) & (SERIAL_TX_SIZE - 1);
+}
+
+/* Wait, at most ms, until the queue is sent and the last byte is out,
+ * e.g. before the serial port is reset. Returns 0 on a timeout.
+ */
+byte serial_drain (uint16 ms)
+{
+  timeout t = timeout_start(ms);
+
+  while (serial_tx_free() != SERIAL_TX_SIZE - 1 || !(S_SR & SSR_TEND))
+    if (timeout_expired(t))
+      return 0;
+  return 1;
+}
+
+/* Queue c for sending. The caller checked serial_tx_free. */
+void serial_tx_put (byte c)
+{
+  byte head = serial_tx_head;
+
+  serial_tx_buf[head] = c;
+  serial_tx_head = (head + 1) & (SERIAL_TX_SIZE - 1);
+}
+
+/* Start the transmit interrupt unless it is running */
+void serial_tx_start (void)
+{
+  byte ccr;
+
+  ccr = irq_save();
+  S_CR = (S_CR & ~(SCR_RE | SCR_TEIE)) | SCR_TIE;
+  irq_restore(ccr);
+}
+
+/* Queue a packet of length bytes for sending. Returns 0, and queues
+ * nothing, if there is no room for the whole packet.
+ */
+byte serial_send (const byte *data, byte length)
+{
+  byte i, sum;
+
+  if (serial_tx_free() < 3 + 2 * (length + 1))
+    return 0;
+
+  serial_tx_put(0x55);
+  serial_tx_put(0xff);
+  serial_tx_put(0x00);
+  sum = 0;
+  for (i = 0; i < length; i++) {
+    serial_tx_put(data[i]);
+    serial_tx_put(~data[i]);
+    sum += data[i];
+  }
+  serial_tx_put(sum);
+  serial_tx_put(~sum);
+
+  serial_tx_start();
+  return 1;
+}
+
+#endif /* RCX_SERIAL_H */
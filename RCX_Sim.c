@@ -0,0 +1,1175 @@
+/*
+ *  RCX_Sim.c
+ *
+ *  H8/300 simulator for RCX programs. Loads an S-record program as
+ *  download does, starts it at 0x8000 and counts the states (clock
+ *  cycles, 16 per us) of every instruction, then prints a profile of
+ *  the states spent in each function.
+ *
+ *  Under UNIX systems like IRIX, Linux, and Solaris, this program compiles
+ *  with gcc RCX_Sim.c -o rcxsim.
+ *
+ *  Usage:
+ *
+ *     rcxsim [options] prog.srec
+ *
+ *     -m prog.map      name functions after the symbols of the linker
+ *                      map, see the Makefile
+ *     -n states        stop after this many states, default 16000000
+ *                      (one second)
+ *     -c addr=states   states of the ROM routine at addr, e.g.
+ *                      -c 0x27c8=20000; adds a routine if not known
+ *     -a ch=value      A/D channel ch (0-3) converts to value (0-1023)
+ *     -t               trace every instruction on stderr
+ *
+ *  The ROM is not simulated. A call of a ROM routine known to rcxsim,
+ *  see rom_routines, returns at once and costs the states given for
+ *  it. Their defaults are rough estimates; measure the real costs on
+ *  a brick and give them with -c. Calling any other ROM address, or
+ *  the reset vector, stops the simulation.
+ *
+ *  The free-running timer and the A/D converter are simulated with
+ *  their interrupts, which the ROM dispatches through the RAM vectors
+ *  at 0xfd80-0xfdbf. The serial interface is always ready to send and
+ *  never receives. Writes to the motor driver at 0xf000 are counted.
+ *  sleep waits for the next interrupt. A jump or branch to itself,
+ *  such as "halt: jmp halt", stops the simulation unless an interrupt
+ *  can end it.
+ *
+ *  States are counted for on-chip memory, without wait states.
+ *
+ *  Profile: a function is entered by jsr, bsr or an interrupt and left
+ *  by rts. "self" are the states of its own instructions, "total"
+ *  includes the functions it called. Without a map, functions are
+ *  named by address.
+ *------------------------------------------------------------------------
+ */
+
+#include <stdio.h>      /* printf, fopen, fgets                          */
+#include <stdlib.h>     /* strtoul, qsort, exit                          */
+#include <string.h>     /* strcmp, strncpy, memset                       */
+#include <ctype.h>      /* isxdigit                                      */
+
+#include "RCX_Map.h"    /* read_map, map_symbols                         */
+
+typedef unsigned char  byte;
+typedef unsigned short word;
+typedef unsigned long long states_t;
+
+#define PROGRAM_START  0x8000
+#define PHI            16000000.0   /* states per second                 */
+#define DEFAULT_LIMIT  16000000ULL
+#define DEFAULT_SP     0xff7e
+
+/* CCR bits */
+#define CCR_C   0x01
+#define CCR_V   0x02
+#define CCR_Z   0x04
+#define CCR_N   0x08
+#define CCR_H   0x20
+#define CCR_I   0x80
+
+/* Profile keys besides addresses */
+#define KEY_SLEEP     0x10000
+#define KEY_DISPATCH  0x10001
+#define KEYS          0x10002
+
+/* Return address of interrupt handlers, see interrupt() */
+#define IRQ_RETURN    0x0002
+
+/*------------------------------------------------------------------------
+ * ROM routines. Calls return at once and cost states.
+ *------------------------------------------------------------------------
+ */
+#define MAX_ROUTINES 32
+
+struct routine_t { word addr;
+                   long states;
+                   char name[32];
+                 };
+typedef struct routine_t routine;
+
+routine rom_routines[MAX_ROUTINES] = {
+    { 0x1b62,   300, "show_icon"   },
+    { 0x1e4a,   300, "hide_icon"   },
+    { 0x1ff2,  2000, "show_number" },
+    { 0x27ac,   400, "clear"       },
+    { 0x27c8, 20000, "refresh"     },
+};
+int rom_count = 5;
+
+routine * find_routine(word addr)
+{
+    int i;
+
+    for (i = 0; i < rom_count; i++)
+        if (rom_routines[i].addr == addr)
+            return &rom_routines[i];
+    return NULL;
+}
+
+/*------------------------------------------------------------------------
+ * Machine state
+ *------------------------------------------------------------------------
+ */
+struct cpu_t { word     r[8];
+               word     pc;
+               byte     ccr;
+               states_t states;
+               states_t limit;
+               int      irq_hold;     /* no interrupt after ldc etc.     */
+               int      trace;
+             };
+typedef struct cpu_t cpu;
+
+byte mem[0x10000];
+cpu  h8;
+
+/* Free-running timer, A/D converter and counters */
+struct io_t { byte     tier, tcsr, tcr, tocr;
+              word     frc, ocra, ocrb;
+              int      frc_div;       /* states to the next count        */
+              byte     adcsr, adcr;
+              word     adr[4];
+              word     ad_value[4];
+              long     ad_left;       /* states to the end of a scan     */
+              byte     motor;
+              long     motor_writes;
+              long     interrupts;
+            };
+typedef struct io_t io;
+
+io dev;
+
+/*------------------------------------------------------------------------
+ * Profile
+ *------------------------------------------------------------------------
+ */
+#define MAX_DEPTH 256
+
+struct func_t { unsigned long calls;
+                states_t      self;
+                states_t      total;
+              };
+typedef struct func_t func;
+
+struct frame_t { long     key;
+                 states_t start;
+                 word     sp;         /* stack pointer at the call       */
+               };
+typedef struct frame_t frame;
+
+func  funcs[KEYS];
+frame stack[MAX_DEPTH];
+int   depth;
+
+/* Key of the function running now */
+long current(void)
+{
+    return depth > 0 ? stack[depth-1].key : PROGRAM_START;
+}
+
+void charge(long states)
+{
+    h8.states += states;
+    funcs[current()].self += states;
+}
+
+void enter(long key)
+{
+    funcs[key].calls++;
+    if (depth == MAX_DEPTH) {
+        /* Drop the outermost frame of a runaway recursion */
+        memmove(&stack[0], &stack[1], (MAX_DEPTH - 1) * sizeof(frame));
+        depth--;
+    }
+    stack[depth].key = key;
+    stack[depth].start = h8.states;
+    stack[depth].sp = h8.r[7];
+    depth++;
+}
+
+/* Leave the function whose return address was just popped. Frames of
+ * functions left without rts, e.g. by a longjmp, are left too.
+ */
+void leave(void)
+{
+    while (depth > 0) {
+        depth--;
+        funcs[stack[depth].key].total += h8.states - stack[depth].start;
+        if (depth == 0 || stack[depth].sp >= h8.r[7] - 2)
+            break;
+    }
+}
+
+/*------------------------------------------------------------------------
+ * Symbols of the linker map
+ *------------------------------------------------------------------------
+ */
+struct symbol_t { long addr;
+                  char name[NAME_LEN];
+                };
+typedef struct symbol_t symbol;
+
+symbol symbols[MAX_ITEMS];
+int    symbol_count;
+
+void read_symbols(char * filename)
+{
+    static map m;
+    static item *found[MAX_ITEMS];
+    int i;
+
+    read_map(filename, &m);
+    symbol_count = map_symbols(&m, 0, 0x10000, found, MAX_ITEMS);
+    for (i = 0; i < symbol_count; i++) {
+        symbols[i].addr = found[i]->addr;
+        strcpy(symbols[i].name, found[i]->name);
+    }
+}
+
+/* Name of the function at key */
+char * key_name(long key)
+{
+    static char buf[NAME_LEN + 16];
+    routine *rt;
+    int i;
+
+    if (key == KEY_SLEEP)
+        return "(sleep)";
+    if (key == KEY_DISPATCH)
+        return "(interrupt dispatch)";
+    if (key < PROGRAM_START && (rt = find_routine(key)) != NULL) {
+        snprintf(buf, sizeof(buf), "rom %s", rt->name);
+        return buf;
+    }
+    for (i = symbol_count - 1; i >= 0; i--)
+        if (symbols[i].addr <= key)
+            break;
+    if (i < 0)
+        snprintf(buf, sizeof(buf), "0x%04lx", key);
+    else if (symbols[i].addr == key)
+        snprintf(buf, sizeof(buf), "%s", symbols[i].name);
+    else
+        snprintf(buf, sizeof(buf), "%s+0x%lx", symbols[i].name,
+                 key - symbols[i].addr);
+    return buf;
+}
+
+/*------------------------------------------------------------------------
+ * S-records, S1 records only
+ *------------------------------------------------------------------------
+ */
+int hex2(char * s)
+{
+    char b[3];
+
+    if (!isxdigit((byte)s[0]) || !isxdigit((byte)s[1]))
+        return -1;
+    b[0] = s[0]; b[1] = s[1]; b[2] = 0;
+    return strtoul(b, NULL, 16);
+}
+
+void read_srec(char * filename)
+{
+    char buf[256];
+    FILE *file;
+    int count, addr, i, v;
+
+    if ((file = fopen(filename, "r")) == NULL) {
+        fprintf(stderr, "%s: failed to open\n", filename);
+        exit(1);
+    }
+    while (fgets(buf, sizeof(buf), file)) {
+        if (buf[0] != 'S' || buf[1] != '1' || (count = hex2(&buf[2])) < 0)
+            continue;
+        addr = (hex2(&buf[4]) << 8) | hex2(&buf[6]);
+        for (i = 0; i < count - 3; i++) {
+            if ((v = hex2(&buf[8 + 2*i])) < 0)
+                break;
+            mem[(addr + i) & 0xffff] = v;
+        }
+    }
+    fclose(file);
+}
+
+/*------------------------------------------------------------------------
+ * On-chip devices
+ *------------------------------------------------------------------------
+ */
+#define AD_STATES 266       /* per channel, 134 with ADCSR CKS            */
+
+void ad_start(void)
+{
+    int channels = (dev.adcsr & 0x10) ? (dev.adcsr & 3) + 1 : 1;
+
+    dev.ad_left = channels * ((dev.adcsr & 0x08) ? 134 : AD_STATES);
+}
+
+/* Let states pass for the timer and the A/D converter */
+void devices(long states)
+{
+    static const int frc_div[4] = { 2, 8, 32, 0 };
+    int ch, div = frc_div[dev.tcr & 3];
+
+    if (div) {
+        dev.frc_div -= states;
+        while (dev.frc_div <= 0) {
+            dev.frc_div += div;
+            if ((dev.tcsr & 0x01) && dev.frc == dev.ocra)
+                dev.frc = 0;
+            else if (++dev.frc == 0)
+                dev.tcsr |= 0x02;                   /* OVF                */
+            if (dev.frc == dev.ocra)
+                dev.tcsr |= 0x08;                   /* OCFA               */
+            if (dev.frc == dev.ocrb)
+                dev.tcsr |= 0x04;                   /* OCFB               */
+        }
+    }
+
+    if ((dev.adcsr & 0x20) && dev.ad_left > 0 &&
+        (dev.ad_left -= states) <= 0) {
+        if (dev.adcsr & 0x10)
+            for (ch = 0; ch <= (dev.adcsr & 3); ch++)
+                dev.adr[ch] = dev.ad_value[ch] << 6;
+        else
+            dev.adr[dev.adcsr & 3] = dev.ad_value[dev.adcsr & 3] << 6;
+        dev.adcsr |= 0x80;                          /* ADF                */
+        if (dev.adcsr & 0x10)
+            ad_start();                             /* scan goes on       */
+        else
+            dev.adcsr &= ~0x20;
+    }
+}
+
+/* RAM vector of the highest priority pending interrupt, 0 if none */
+word pending(void)
+{
+    if ((dev.tier & 0x08) && (dev.tcsr & 0x08))
+        return 0xfda2;                              /* OCIA               */
+    if ((dev.tier & 0x04) && (dev.tcsr & 0x04))
+        return 0xfda4;                              /* OCIB               */
+    if ((dev.tier & 0x02) && (dev.tcsr & 0x02))
+        return 0xfda6;                              /* FOVI               */
+    if ((dev.adcsr & 0x40) && (dev.adcsr & 0x80))
+        return 0xfdbc;                              /* ADI                */
+    return 0;
+}
+
+/* An interrupt source is enabled */
+int can_interrupt(void)
+{
+    return !(h8.ccr & CCR_I) &&
+           ((dev.tier & 0x0e && (dev.tcr & 3) != 3) ||
+            ((dev.adcsr & 0x60) == 0x60));
+}
+
+byte io_read8(word a)
+{
+    switch (a) {
+    case 0xff90: return dev.tier;
+    case 0xff91: return dev.tcsr;
+    case 0xff92: return dev.frc >> 8;
+    case 0xff93: return dev.frc;
+    case 0xff94: return ((dev.tocr & 0x10) ? dev.ocrb : dev.ocra) >> 8;
+    case 0xff95: return  (dev.tocr & 0x10) ? dev.ocrb : dev.ocra;
+    case 0xff96: return dev.tcr;
+    case 0xff97: return dev.tocr;
+    case 0xffdc: return 0x84;                       /* TDRE, TEND         */
+    case 0xffe8: return dev.adcsr;
+    case 0xffe9: return dev.adcr;
+    }
+    if (a >= 0xffe0 && a < 0xffe8)
+        return (a & 1) ? dev.adr[(a - 0xffe0) >> 1]
+                       : dev.adr[(a - 0xffe0) >> 1] >> 8;
+    return mem[a];
+}
+
+void io_write8(word a, byte v)
+{
+    word *ocr = (dev.tocr & 0x10) ? &dev.ocrb : &dev.ocra;
+
+    switch (a) {
+    case 0xff90: dev.tier = v; return;
+    case 0xff91: dev.tcsr = (dev.tcsr & v & 0xfe) | (v & 0x01); return;
+    case 0xff92: dev.frc = (dev.frc & 0x00ff) | v << 8; return;
+    case 0xff93: dev.frc = (dev.frc & 0xff00) | v; return;
+    case 0xff94: *ocr = (*ocr & 0x00ff) | v << 8; return;
+    case 0xff95: *ocr = (*ocr & 0xff00) | v; return;
+    case 0xff96: dev.tcr = v; return;
+    case 0xff97: dev.tocr = v; return;
+    case 0xffe8:
+        dev.adcsr = (dev.adcsr & v & 0x80) | (v & 0x7f);
+        if ((v & 0x20) && dev.ad_left <= 0)
+            ad_start();
+        if (!(v & 0x20))
+            dev.ad_left = 0;
+        return;
+    case 0xffe9: dev.adcr = v; return;
+    }
+    mem[a] = v;
+}
+
+byte rd8(word a)
+{
+    return a >= 0xff80 ? io_read8(a) : mem[a];
+}
+
+word rd16(word a)
+{
+    a &= ~1;
+    return rd8(a) << 8 | rd8(a + 1);
+}
+
+void wr8(word a, byte v)
+{
+    if (a == 0xf000) {
+        dev.motor = v;
+        dev.motor_writes++;
+    }
+    if (a >= 0xff80)
+        io_write8(a, v);
+    else
+        mem[a] = v;
+}
+
+void wr16(word a, word v)
+{
+    a &= ~1;
+    if (a >= 0xff80) {
+        io_write8(a, v >> 8);
+        io_write8(a + 1, v);
+    }
+    else {
+        wr8(a, v >> 8);
+        wr8(a + 1, v);
+    }
+}
+
+/*------------------------------------------------------------------------
+ * Registers and flags
+ *------------------------------------------------------------------------
+ */
+byte getr8(int n)
+{
+    return (n & 8) ? h8.r[n & 7] & 0xff : h8.r[n & 7] >> 8;
+}
+
+void setr8(int n, byte v)
+{
+    if (n & 8)
+        h8.r[n & 7] = (h8.r[n & 7] & 0xff00) | v;
+    else
+        h8.r[n & 7] = (h8.r[n & 7] & 0x00ff) | v << 8;
+}
+
+void flag(byte f, int set)
+{
+    if (set)
+        h8.ccr |= f;
+    else
+        h8.ccr &= ~f;
+}
+
+/* N and Z of a move or logic result, V cleared */
+void nz8(byte v)
+{
+    flag(CCR_N, v & 0x80);
+    flag(CCR_Z, v == 0);
+    flag(CCR_V, 0);
+}
+
+void nz16(word v)
+{
+    flag(CCR_N, v & 0x8000);
+    flag(CCR_Z, v == 0);
+    flag(CCR_V, 0);
+}
+
+/* a + b + c. With keep_z, as addx, Z is only ever cleared. */
+byte add8(byte a, byte b, int c, int keep_z)
+{
+    int r = a + b + c;
+
+    flag(CCR_H, (a & 0xf) + (b & 0xf) + c > 0xf);
+    flag(CCR_C, r > 0xff);
+    flag(CCR_V, ~(a ^ b) & (a ^ r) & 0x80);
+    flag(CCR_N, r & 0x80);
+    if (!keep_z || (r & 0xff))
+        flag(CCR_Z, (r & 0xff) == 0);
+    return r;
+}
+
+byte sub8(byte a, byte b, int c, int keep_z)
+{
+    int r = a - b - c;
+
+    flag(CCR_H, (a & 0xf) - (b & 0xf) - c < 0);
+    flag(CCR_C, r < 0);
+    flag(CCR_V, (a ^ b) & (a ^ r) & 0x80);
+    flag(CCR_N, r & 0x80);
+    if (!keep_z || (r & 0xff))
+        flag(CCR_Z, (r & 0xff) == 0);
+    return r;
+}
+
+word add16(word a, word b)
+{
+    long r = (long)a + b;
+
+    flag(CCR_H, (a & 0xfff) + (b & 0xfff) > 0xfff);
+    flag(CCR_C, r > 0xffff);
+    flag(CCR_V, ~(a ^ b) & (a ^ r) & 0x8000);
+    flag(CCR_N, r & 0x8000);
+    flag(CCR_Z, (r & 0xffff) == 0);
+    return r;
+}
+
+word sub16(word a, word b)
+{
+    long r = (long)a - b;
+
+    flag(CCR_H, (long)(a & 0xfff) - (b & 0xfff) < 0);
+    flag(CCR_C, r < 0);
+    flag(CCR_V, (a ^ b) & (a ^ r) & 0x8000);
+    flag(CCR_N, r & 0x8000);
+    flag(CCR_Z, (r & 0xffff) == 0);
+    return r;
+}
+
+int condition(int cc)
+{
+    int c = h8.ccr & CCR_C, v = !!(h8.ccr & CCR_V);
+    int z = h8.ccr & CCR_Z, n = !!(h8.ccr & CCR_N);
+
+    switch (cc) {
+    case 0x0: return 1;                             /* bra                */
+    case 0x1: return 0;                             /* brn                */
+    case 0x2: return !(c || z);                     /* bhi                */
+    case 0x3: return c || z;                        /* bls                */
+    case 0x4: return !c;                            /* bcc                */
+    case 0x5: return c;                             /* bcs                */
+    case 0x6: return !z;                            /* bne                */
+    case 0x7: return z;                             /* beq                */
+    case 0x8: return !v;                            /* bvc                */
+    case 0x9: return v;                             /* bvs                */
+    case 0xa: return !n;                            /* bpl                */
+    case 0xb: return n;                             /* bmi                */
+    case 0xc: return n == v;                        /* bge                */
+    case 0xd: return n != v;                        /* blt                */
+    case 0xe: return !z && n == v;                  /* bgt                */
+    default:  return z || n != v;                   /* ble                */
+    }
+}
+
+/*------------------------------------------------------------------------
+ * Stop reasons
+ *------------------------------------------------------------------------
+ */
+char stop_reason[128];
+
+void stop(char * reason, word addr)
+{
+    if (!stop_reason[0])
+        snprintf(stop_reason, sizeof(stop_reason), "%s at 0x%04x",
+                 reason, addr);
+}
+
+/*------------------------------------------------------------------------
+ * Control transfer
+ *------------------------------------------------------------------------
+ */
+void push16(word v)
+{
+    h8.r[7] -= 2;
+    wr16(h8.r[7], v);
+}
+
+word pop16(void)
+{
+    word v = rd16(h8.r[7]);
+
+    h8.r[7] += 2;
+    return v;
+}
+
+/* Jump to target from the instruction at pc. A jump to itself stops
+ * the simulation unless an interrupt can end the loop.
+ */
+void jump(word pc, word target)
+{
+    if (target == pc && !can_interrupt())
+        stop("halt loop", pc);
+    h8.pc = target;
+}
+
+/* Call target, returning to next */
+void call(word pc, word next, word target)
+{
+    routine *rt;
+
+    if (target < PROGRAM_START) {
+        if (target == 0 || (rt = find_routine(target)) == NULL) {
+            stop(target == 0 ? "reset" : "call of unknown ROM routine",
+                 pc);
+            return;
+        }
+        funcs[target].calls++;
+        funcs[target].self += rt->states;
+        funcs[target].total += rt->states;
+        h8.states += rt->states;
+        devices(rt->states);
+        h8.pc = next;
+        return;
+    }
+    push16(next);
+    enter(target);
+    h8.pc = target;
+}
+
+void ret(void)
+{
+    h8.pc = pop16();
+    leave();
+}
+
+/* Accept the interrupt through the RAM vector at vector: save PC and
+ * CCR, then do what the ROM does: push r6, load the vector into r6 and
+ * jsr @r6. The handler returns to IRQ_RETURN, where pop r6 and rte
+ * follow.
+ */
+void interrupt(word vector)
+{
+    word handler = rd16(vector);
+
+    dev.interrupts++;
+    push16(h8.pc);
+    push16(h8.ccr << 8 | h8.ccr);
+    h8.ccr |= CCR_I;
+    push16(h8.r[6]);
+    h8.r[6] = handler;
+
+    h8.states += 14 + 18;
+    funcs[KEY_DISPATCH].self += 14 + 18;
+    devices(14 + 18);
+
+    if (handler < PROGRAM_START) {
+        stop("interrupt without handler", vector);
+        return;
+    }
+    push16(IRQ_RETURN);
+    enter(handler);
+    h8.pc = handler;
+}
+
+void irq_return(void)
+{
+    h8.r[6] = pop16();
+    h8.ccr = pop16() >> 8;
+    h8.pc = pop16();
+    h8.states += 16;
+    funcs[KEY_DISPATCH].self += 16;
+    devices(16);
+}
+
+/* sleep: let time pass until an interrupt is pending */
+void sleep_wait(word pc)
+{
+    if (!can_interrupt()) {
+        stop("sleep with no interrupt enabled", pc);
+        return;
+    }
+    while (!pending() && h8.states < h8.limit) {
+        h8.states += 2;
+        funcs[KEY_SLEEP].self += 2;
+        devices(2);
+    }
+}
+
+/*------------------------------------------------------------------------
+ * Bit instructions. spec is the byte with the bit number in bits 6-4
+ * and the invert flag in bit 7; for 60-63 its high nibble names the
+ * register holding the bit number.
+ *------------------------------------------------------------------------
+ */
+byte bit_op(byte op, byte spec, byte v, int * write)
+{
+    int bit, inv = spec & 0x80, c = h8.ccr & CCR_C, b;
+
+    if (op >= 0x60 && op <= 0x63)
+        bit = getr8(spec >> 4) & 7;
+    else
+        bit = (spec >> 4) & 7;
+    b = (v >> bit) & 1;
+    *write = 0;
+
+    switch (op) {
+    case 0x60: case 0x70: v |= 1 << bit; *write = 1; break;     /* bset   */
+    case 0x61: case 0x71: v ^= 1 << bit; *write = 1; break;     /* bnot   */
+    case 0x62: case 0x72: v &= ~(1 << bit); *write = 1; break;  /* bclr   */
+    case 0x63: case 0x73: flag(CCR_Z, !b); break;               /* btst   */
+    case 0x67:                                                  /* bst    */
+        if ((c != 0) != (inv != 0))
+            v |= 1 << bit;
+        else
+            v &= ~(1 << bit);
+        *write = 1;
+        break;
+    case 0x74: flag(CCR_C, c || (b ^ !!inv)); break;            /* bor    */
+    case 0x75: flag(CCR_C, (c != 0) ^ (b ^ !!inv)); break;      /* bxor   */
+    case 0x76: flag(CCR_C, c && (b ^ !!inv)); break;            /* band   */
+    case 0x77: flag(CCR_C, b ^ !!inv); break;                   /* bld    */
+    }
+    return v;
+}
+
+/*------------------------------------------------------------------------
+ * step: execute one instruction
+ *------------------------------------------------------------------------
+ */
+void illegal(word pc)
+{
+    stop("illegal instruction", pc);
+}
+
+void step(void)
+{
+    word pc = h8.pc, a, w, v16;
+    byte op, b1, v, spec;
+    int n = 2, rs, rd, write, i;
+    long r;
+
+    if (pc == IRQ_RETURN) {
+        irq_return();
+        return;
+    }
+    if (pc < PROGRAM_START) {
+        stop("jump into the ROM", pc);
+        return;
+    }
+
+    op = mem[pc];
+    b1 = mem[(word)(pc + 1)];
+    w  = mem[(word)(pc + 2)] << 8 | mem[(word)(pc + 3)];
+    rs = b1 >> 4;
+    rd = b1 & 0xf;
+    h8.pc = pc + 2;
+
+    if (h8.trace)
+        fprintf(stderr, "%10llu %04x  %02x%02x  r0-7 %04x %04x %04x %04x "
+                "%04x %04x %04x %04x ccr %02x\n", h8.states, pc, op, b1,
+                h8.r[0], h8.r[1], h8.r[2], h8.r[3], h8.r[4], h8.r[5],
+                h8.r[6], h8.r[7], h8.ccr);
+
+    switch (op >> 4) {
+    case 0x2:                                       /* mov.b @aa:8,rd     */
+        v = rd8(0xff00 | b1);
+        setr8(op & 0xf, v);
+        nz8(v);
+        n = 4;
+        goto done;
+    case 0x3:                                       /* mov.b rs,@aa:8     */
+        v = getr8(op & 0xf);
+        wr8(0xff00 | b1, v);
+        nz8(v);
+        n = 4;
+        goto done;
+    case 0x4:                                       /* bcc d:8            */
+        if (condition(op & 0xf))
+            jump(pc, h8.pc + (signed char)b1);
+        n = 4;
+        goto done;
+    case 0x8: setr8(op & 0xf, add8(getr8(op & 0xf), b1, 0, 0)); goto done;
+    case 0x9: setr8(op & 0xf, add8(getr8(op & 0xf), b1,
+                                   h8.ccr & CCR_C, 1)); goto done;
+    case 0xa: sub8(getr8(op & 0xf), b1, 0, 0); goto done;
+    case 0xb: setr8(op & 0xf, sub8(getr8(op & 0xf), b1,
+                                   h8.ccr & CCR_C, 1)); goto done;
+    case 0xc: v = getr8(op & 0xf) | b1; setr8(op & 0xf, v); nz8(v);
+              goto done;
+    case 0xd: v = getr8(op & 0xf) ^ b1; setr8(op & 0xf, v); nz8(v);
+              goto done;
+    case 0xe: v = getr8(op & 0xf) & b1; setr8(op & 0xf, v); nz8(v);
+              goto done;
+    case 0xf: setr8(op & 0xf, b1); nz8(b1); goto done;
+    }
+
+    switch (op) {
+    case 0x00:                                      /* nop                */
+        break;
+    case 0x01:                                      /* sleep              */
+        if (b1 != 0x80)
+            return illegal(pc);
+        sleep_wait(pc);
+        break;
+    case 0x02: setr8(rd, h8.ccr); break;            /* stc ccr,rd         */
+    case 0x03: h8.ccr = getr8(rd); h8.irq_hold = 1; break;  /* ldc rs,ccr */
+    case 0x04: h8.ccr |= b1; h8.irq_hold = 1; break;        /* orc        */
+    case 0x05: h8.ccr ^= b1; h8.irq_hold = 1; break;        /* xorc       */
+    case 0x06: h8.ccr &= b1; h8.irq_hold = 1; break;        /* andc       */
+    case 0x07: h8.ccr = b1; h8.irq_hold = 1; break;         /* ldc #      */
+    case 0x08: setr8(rd, add8(getr8(rd), getr8(rs), 0, 0)); break;
+    case 0x09: h8.r[rd & 7] = add16(h8.r[rd & 7], h8.r[rs & 7]); break;
+    case 0x0a:                                      /* inc.b              */
+        v = getr8(rd) + 1;
+        flag(CCR_V, v == 0x80);
+        flag(CCR_N, v & 0x80);
+        flag(CCR_Z, v == 0);
+        setr8(rd, v);
+        break;
+    case 0x0b:                                      /* adds #1/#2         */
+        h8.r[rd & 7] += (rs & 8) ? 2 : 1;
+        break;
+    case 0x0c: v = getr8(rs); setr8(rd, v); nz8(v); break;
+    case 0x0d: h8.r[rd & 7] = h8.r[rs & 7]; nz16(h8.r[rd & 7]); break;
+    case 0x0e: setr8(rd, add8(getr8(rd), getr8(rs), h8.ccr & CCR_C, 1));
+               break;
+    case 0x0f:                                      /* daa                */
+    case 0x1f:                                      /* das                */
+        v = getr8(rd);
+        i = 0;
+        if ((h8.ccr & CCR_H) || (op == 0x0f && (v & 0xf) > 9))
+            i |= 0x06;
+        if ((h8.ccr & CCR_C) || (op == 0x0f && v > 0x99)) {
+            i |= 0x60;
+            h8.ccr |= CCR_C;
+        }
+        v = (op == 0x0f) ? v + i : v - i;
+        setr8(rd, v);
+        flag(CCR_N, v & 0x80);
+        flag(CCR_Z, v == 0);
+        break;
+    case 0x10: case 0x11: case 0x12: case 0x13:     /* shifts, rotations  */
+        v = getr8(rd);
+        switch ((op & 3) << 1 | (rs >> 3)) {
+        case 0: flag(CCR_C, v & 0x80); v <<= 1; flag(CCR_V, 0); break;
+        case 1: flag(CCR_C, v & 0x80);
+                flag(CCR_V, (v ^ (v << 1)) & 0x80); v <<= 1; break;
+        case 2: flag(CCR_C, v & 1); v >>= 1; flag(CCR_V, 0); break;
+        case 3: flag(CCR_C, v & 1); v = (v >> 1) | (v & 0x80);
+                flag(CCR_V, 0); break;
+        case 4: i = h8.ccr & CCR_C; flag(CCR_C, v & 0x80);
+                v = (v << 1) | i; flag(CCR_V, 0); break;
+        case 5: flag(CCR_C, v & 0x80); v = (v << 1) | (v >> 7);
+                flag(CCR_V, 0); break;
+        case 6: i = h8.ccr & CCR_C; flag(CCR_C, v & 1);
+                v = (v >> 1) | (i << 7); flag(CCR_V, 0); break;
+        case 7: flag(CCR_C, v & 1); v = (v >> 1) | (v << 7);
+                flag(CCR_V, 0); break;
+        }
+        flag(CCR_N, v & 0x80);
+        flag(CCR_Z, v == 0);
+        setr8(rd, v);
+        break;
+    case 0x14: v = getr8(rd) | getr8(rs); setr8(rd, v); nz8(v); break;
+    case 0x15: v = getr8(rd) ^ getr8(rs); setr8(rd, v); nz8(v); break;
+    case 0x16: v = getr8(rd) & getr8(rs); setr8(rd, v); nz8(v); break;
+    case 0x17:                                      /* not, neg           */
+        if (rs & 8)
+            setr8(rd, sub8(0, getr8(rd), 0, 0));
+        else {
+            v = ~getr8(rd);
+            setr8(rd, v);
+            nz8(v);
+        }
+        break;
+    case 0x18: setr8(rd, sub8(getr8(rd), getr8(rs), 0, 0)); break;
+    case 0x19: h8.r[rd & 7] = sub16(h8.r[rd & 7], h8.r[rs & 7]); break;
+    case 0x1a:                                      /* dec.b              */
+        v = getr8(rd) - 1;
+        flag(CCR_V, v == 0x7f);
+        flag(CCR_N, v & 0x80);
+        flag(CCR_Z, v == 0);
+        setr8(rd, v);
+        break;
+    case 0x1b:                                      /* subs #1/#2         */
+        h8.r[rd & 7] -= (rs & 8) ? 2 : 1;
+        break;
+    case 0x1c: sub8(getr8(rd), getr8(rs), 0, 0); break;
+    case 0x1d: sub16(h8.r[rd & 7], h8.r[rs & 7]); break;
+    case 0x1e: setr8(rd, sub8(getr8(rd), getr8(rs), h8.ccr & CCR_C, 1));
+               break;
+    case 0x50:                                      /* mulxu              */
+        h8.r[rd & 7] = (h8.r[rd & 7] & 0xff) * getr8(rs);
+        n = 14;
+        break;
+    case 0x51:                                      /* divxu              */
+        v = getr8(rs);
+        flag(CCR_N, v & 0x80);
+        flag(CCR_Z, v == 0);
+        if (v) {
+            v16 = h8.r[rd & 7];
+            h8.r[rd & 7] = (v16 % v) << 8 | ((v16 / v) & 0xff);
+        }
+        n = 14;
+        break;
+    case 0x54:                                      /* rts                */
+        ret();
+        n = 8;
+        break;
+    case 0x55:                                      /* bsr d:8            */
+        call(pc, h8.pc, h8.pc + (signed char)b1);
+        n = 6;
+        break;
+    case 0x56:                                      /* rte                */
+        h8.ccr = pop16() >> 8;
+        h8.pc = pop16();
+        n = 10;
+        break;
+    case 0x59:                                      /* jmp @rn            */
+        jump(pc, h8.r[rs & 7]);
+        n = 4;
+        break;
+    case 0x5a:                                      /* jmp @aa:16         */
+        h8.pc = pc + 4;
+        jump(pc, w);
+        n = 6;
+        break;
+    case 0x5b:                                      /* jmp @@aa:8         */
+        a = rd16(b1);
+        if (a == 0)
+            stop("reset", pc);
+        else
+            jump(pc, a);
+        n = 8;
+        break;
+    case 0x5d:                                      /* jsr @rn            */
+        call(pc, h8.pc, h8.r[rs & 7]);
+        n = 6;
+        break;
+    case 0x5e:                                      /* jsr @aa:16         */
+        call(pc, pc + 4, w);
+        n = 8;
+        break;
+    case 0x5f:                                      /* jsr @@aa:8         */
+        call(pc, h8.pc, rd16(b1));
+        n = 8;
+        break;
+    case 0x60: case 0x61: case 0x62: case 0x63:     /* bit ops rn,rd      */
+    case 0x67: case 0x70: case 0x71: case 0x72:
+    case 0x73: case 0x74: case 0x75: case 0x76: case 0x77:
+        v = bit_op(op, b1 & 0xf0, getr8(rd), &write);
+        if (write)
+            setr8(rd, v);
+        break;
+    case 0x68: case 0x69: case 0x6c: case 0x6d:     /* mov @rs, @rs+, @-rd */
+    case 0x6e: case 0x6f:                           /* mov @(d:16,rs)     */
+        a = h8.r[rs & 7];
+        if (op == 0x6e || op == 0x6f) {
+            a += w;
+            h8.pc = pc + 4;
+            n = 6;
+        }
+        else if (op == 0x6c || op == 0x6d) {
+            n = 6;
+            if (rs & 8) {
+                a -= (op & 1) ? 2 : 1;
+                h8.r[rs & 7] = a;
+            }
+            else
+                h8.r[rs & 7] += (op & 1) ? 2 : 1;
+        }
+        else
+            n = 4;
+        if (op & 1) {
+            if (rs & 8) {
+                wr16(a, h8.r[rd & 7]);
+                nz16(h8.r[rd & 7]);
+            }
+            else {
+                h8.r[rd & 7] = rd16(a);
+                nz16(h8.r[rd & 7]);
+            }
+        }
+        else {
+            if (rs & 8) {
+                wr8(a, getr8(rd));
+                nz8(getr8(rd));
+            }
+            else {
+                v = rd8(a);
+                setr8(rd, v);
+                nz8(v);
+            }
+        }
+        break;
+    case 0x6a: case 0x6b:                           /* mov @aa:16         */
+        h8.pc = pc + 4;
+        n = 6;
+        if (op & 1) {
+            if (rs & 8)
+                wr16(w, h8.r[rd & 7]);
+            else
+                h8.r[rd & 7] = rd16(w);
+            nz16(h8.r[rd & 7]);
+        }
+        else {
+            if (rs & 8)
+                wr8(w, getr8(rd));
+            else
+                setr8(rd, rd8(w));
+            nz8(getr8(rd));
+        }
+        break;
+    case 0x79:                                      /* mov.w #xx:16,rd    */
+        if (rs != 0)
+            return illegal(pc);
+        h8.r[rd & 7] = w;
+        nz16(w);
+        h8.pc = pc + 4;
+        n = 4;
+        break;
+    case 0x7b:                                      /* eepmov             */
+        if (b1 != 0x5c || w != 0x598f)
+            return illegal(pc);
+        h8.pc = pc + 4;
+        n = 8;                                      /* 8 + 4 per byte     */
+        while (h8.r[4] & 0xff) {
+            wr8(h8.r[6]++, rd8(h8.r[5]++));
+            setr8(0xc, getr8(0xc) - 1);
+            n += 4;
+        }
+        break;
+    case 0x7c: case 0x7d: case 0x7e: case 0x7f:     /* bit ops on memory  */
+        a = (op & 2) ? 0xff00 | b1 : h8.r[rs & 7];
+        spec = mem[(word)(pc + 3)];
+        h8.pc = pc + 4;
+        v = bit_op(mem[(word)(pc + 2)], spec, rd8(a), &write);
+        if (write)
+            wr8(a, v);
+        n = write ? 8 : 6;
+        break;
+    default:
+        return illegal(pc);
+    }
+
+done:
+    r = n;
+    charge(r);
+    devices(r);
+}
+
+/*------------------------------------------------------------------------
+ * run: until a stop or the state limit
+ *------------------------------------------------------------------------
+ */
+void run(void)
+{
+    word vector;
+    int hold;
+
+    h8.pc = PROGRAM_START;
+    h8.r[7] = DEFAULT_SP;
+    h8.ccr = 0;
+
+    while (!stop_reason[0] && h8.states < h8.limit) {
+        hold = h8.irq_hold;
+        h8.irq_hold = 0;
+        step();
+        if (!hold && !h8.irq_hold && !(h8.ccr & CCR_I) &&
+            (vector = pending()) != 0)
+            interrupt(vector);
+    }
+    if (!stop_reason[0])
+        stop("state limit", h8.pc);
+}
+
+/*------------------------------------------------------------------------
+ * Report
+ *------------------------------------------------------------------------
+ */
+int by_self(const void * a, const void * b)
+{
+    const long *x = a, *y = b;
+
+    if (funcs[*x].self != funcs[*y].self)
+        return funcs[*y].self > funcs[*x].self ? 1 : -1;
+    return *x < *y ? -1 : *x > *y;
+}
+
+void report(void)
+{
+    static long keys[KEYS];
+    int count = 0, i;
+    double total = h8.states ? (double)h8.states : 1.0;
+
+    /* Frames still open count until now */
+    for (i = depth - 1; i >= 0; i--)
+        funcs[stack[i].key].total += h8.states - stack[i].start;
+    funcs[PROGRAM_START].total = h8.states;
+
+    for (i = 0; i < KEYS; i++)
+        if (funcs[i].self || funcs[i].calls)
+            keys[count++] = i;
+    qsort(keys, count, sizeof(long), by_self);
+
+    printf("rcxsim: %s after %llu states (%.6f s)\n", stop_reason,
+           h8.states, h8.states / PHI);
+    printf("%12s %6s %12s %9s  %s\n", "self", "%", "total", "calls",
+           "function");
+    for (i = 0; i < count; i++)
+        printf("%12llu %6.2f %12llu %9lu  %s\n", funcs[keys[i]].self,
+               100.0 * funcs[keys[i]].self / total, funcs[keys[i]].total,
+               funcs[keys[i]].calls, key_name(keys[i]));
+    printf("%ld interrupts, %ld motor writes, last 0x%02x\n",
+           dev.interrupts, dev.motor_writes, dev.motor);
+}
+
+void usage(char * name)
+{
+    fprintf(stderr, "usage: %s [-m map] [-n states] [-c addr=states]... "
+            "[-a ch=value]... [-t] srec\n", name);
+    exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+    char *eq, *map_name = NULL;
+    unsigned long addr;
+    routine *rt;
+    int i, ch;
+
+    h8.limit = DEFAULT_LIMIT;
+    for (ch = 0; ch < 4; ch++)
+        dev.ad_value[ch] = 0x3ff;       /* open inputs read high          */
+    dev.ocra = dev.ocrb = 0xffff;
+    dev.frc_div = 2;
+
+    for (i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc - 1)
+            map_name = argv[++i];
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc - 1)
+            h8.limit = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc - 1 &&
+                 (eq = strchr(argv[++i], '=')) != NULL) {
+            addr = strtoul(argv[i], NULL, 0);
+            if ((rt = find_routine(addr)) == NULL) {
+                if (addr == 0 || addr >= PROGRAM_START ||
+                    rom_count == MAX_ROUTINES)
+                    usage(argv[0]);
+                rt = &rom_routines[rom_count++];
+                rt->addr = addr;
+                snprintf(rt->name, sizeof(rt->name), "0x%04lx", addr);
+            }
+            rt->states = strtol(eq + 1, NULL, 0);
+        }
+        else if (!strcmp(argv[i], "-a") && i + 1 < argc - 1 &&
+                 (eq = strchr(argv[++i], '=')) != NULL &&
+                 (ch = strtol(argv[i], NULL, 0)) >= 0 && ch < 4)
+            dev.ad_value[ch] = strtol(eq + 1, NULL, 0) & 0x3ff;
+        else if (!strcmp(argv[i], "-t"))
+            h8.trace = 1;
+        else
+            usage(argv[0]);
+    }
+    if (i != argc - 1)
+        usage(argv[0]);
+
+    if (map_name != NULL)
+        read_symbols(map_name);
+    read_srec(argv[argc - 1]);
+    run();
+    report();
+
+    exit(0);
+}
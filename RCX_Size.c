@@ -0,0 +1,435 @@
+/*
+ *  RCX_Size.c
+ *
+ *  Download size profiler. Attributes every byte that download sends
+ *  for an S-record program to a symbol and section of the linker map
+ *  of the program, and estimates the IR transfer time of each.
+ *
+ *  Under UNIX systems like IRIX, Linux, and Solaris, this program compiles
+ *  with gcc RCX_Size.c -o rcxsize.
+ *
+ *  Usage:
+ *
+ *     rcxsize prog.map prog.srec
+ *        Profile of one build, largest first.
+ *
+ *     rcxsize -d old.map old.srec new.map new.srec
+ *        Difference between two builds, largest change first.
+ *
+ *     rcxsize -b budget prog.srec ...
+ *        Bytes and transfer time of each program. Exits with 1 if one
+ *        is larger than budget bytes, e.g. 0x4c00 (IMAGE_LEN).
+ *
+ *     rcxsize -z rcx.lds prog.map prog.srec > prog.lds
+ *        Linker script that moves the .data and .rodata input sections
+ *        holding only zeros into .bss, see write_zero_layout.
+ *
+ *  The map file is written by the linker with -Map, see the Makefile.
+ *  Bytes not covered by an input section of the map are reported as
+ *  (fill) inside an output section or (gap) between sections. Bytes of
+ *  an input section before its first symbol are reported under the
+ *  name of the object file.
+ *------------------------------------------------------------------------
+ */
+
+#include <stdio.h>      /* printf, fopen, fgets                          */
+#include <stdlib.h>     /* strtoul, qsort, exit                          */
+#include <string.h>     /* strcmp, strncpy, memset                       */
+#include <strings.h>    /* strncasecmp                                   */
+#include <ctype.h>      /* isxdigit                                      */
+
+#include "RCX_Map.h"    /* read_map: sections and symbols of the map     */
+
+/*------------------------------------------------------------------------
+ * Download parameters, as in RCX_Download.c.
+ *
+ * Each image byte is sent as the byte and its complement. Each block
+ * of TRANSFER_SIZE bytes adds a header, the block request, a checksum
+ * and the reply, and the reply ends with a read timeout of 0.1 s.
+ * A byte on the line is 11 bits: start, 8 data, parity and stop bit.
+ *------------------------------------------------------------------------
+ */
+#define IMAGE_START   0x8000
+#define IMAGE_LEN     0x4c00
+#define IMAGE_END     (IMAGE_START + IMAGE_LEN)
+#define TRANSFER_SIZE 0xc8
+
+#define BAUD           2400
+#define BITS_PER_BYTE  11
+#define BLOCK_OVERHEAD (3 + 2 * 6 + 3 + 2 * 2)  /* IR bytes of request
+                                                   and reply framing */
+#define READ_TIMEOUT   0.1
+
+typedef unsigned char byte;
+
+double byte_seconds(void)
+{
+    return 2.0 * BITS_PER_BYTE / BAUD;
+}
+
+double block_seconds(void)
+{
+    return (double)BLOCK_OVERHEAD * BITS_PER_BYTE / BAUD + READ_TIMEOUT;
+}
+
+/* Transfer time of an image of length bytes */
+double image_seconds(int length)
+{
+    int blocks = (length + TRANSFER_SIZE - 1) / TRANSFER_SIZE;
+
+    return length * byte_seconds() + blocks * block_seconds();
+}
+
+/*------------------------------------------------------------------------
+ * Image: the bytes download sends, found as in RCX_Download.c. The
+ * length is the end of the highest S1 record, or the last nonzero
+ * byte if the S0 record is ?LIB_VERSION_L00.
+ *------------------------------------------------------------------------
+ */
+struct image_t { byte data[IMAGE_LEN];
+                 int  length;
+               };
+typedef struct image_t image;
+
+int hex2(char * s)
+{
+    char b[3];
+
+    if (!isxdigit((byte)s[0]) || !isxdigit((byte)s[1]))
+        return -1;
+    b[0] = s[0]; b[1] = s[1]; b[2] = 0;
+    return strtoul(b, NULL, 16);
+}
+
+void read_image(char * filename, image * im)
+{
+    char buf[256];
+    FILE *file;
+    int count, addr, i, v, strip = 0;
+
+    if ((file = fopen(filename, "r")) == NULL) {
+        fprintf(stderr, "%s: failed to open\n", filename);
+        exit(1);
+    }
+
+    memset(im, 0, sizeof(image));
+    while (fgets(buf, sizeof(buf), file)) {
+        if (buf[0] != 'S' || (count = hex2(&buf[2])) < 0)
+            continue;
+        if (buf[1] == '0' && count == 19 &&
+            !strncasecmp(&buf[8], "3F4C49425F56455253494F4E5F4C3030", 32))
+            strip = 1;      /* ?LIB_VERSION_L00 */
+        if (buf[1] != '1')
+            continue;
+        addr = (hex2(&buf[4]) << 8) | hex2(&buf[6]);
+        for (i = 0; i < count - 3; i++) {
+            if ((v = hex2(&buf[8 + 2*i])) < 0)
+                break;
+            if (addr + i < IMAGE_START || addr + i >= IMAGE_END) {
+                fprintf(stderr, "%s: address out of bounds\n", filename);
+                exit(1);
+            }
+            im->data[addr + i - IMAGE_START] = v;
+        }
+        if (!strip && addr + i - IMAGE_START > im->length)
+            im->length = addr + i - IMAGE_START;
+    }
+    fclose(file);
+
+    if (strip) {
+        for (i = IMAGE_LEN - 1; i >= 0 && im->data[i] == 0; i--);
+        im->length = i + 1;
+    }
+}
+
+/*------------------------------------------------------------------------
+ * Profile: bytes per (section, symbol).
+ *
+ * profile_image walks the image bytes in address order and charges
+ * each byte to the symbol covering it: the last symbol at or below
+ * the byte inside the input section, or the input section itself.
+ *------------------------------------------------------------------------
+ */
+struct entry_t { char section[NAME_LEN];
+                 char name[NAME_LEN];
+                 long bytes;
+                 long old_bytes;
+               };
+typedef struct entry_t entry;
+
+struct profile_t { entry entries[MAX_ITEMS];
+                   int   count;
+                   long  bytes;
+                 };
+typedef struct profile_t profile;
+
+entry * find_entry(profile * p, char * section, char * name)
+{
+    int i;
+
+    for (i = 0; i < p->count; i++)
+        if (!strcmp(p->entries[i].section, section) &&
+            !strcmp(p->entries[i].name, name))
+            return &p->entries[i];
+
+    if (p->count == MAX_ITEMS) {
+        fprintf(stderr, "rcxsize: too many symbols\n");
+        exit(1);
+    }
+    memset(&p->entries[p->count], 0, sizeof(entry));
+    strcpy(p->entries[p->count].section, section);
+    strcpy(p->entries[p->count].name, name);
+    return &p->entries[p->count++];
+}
+
+/* Name and section charged for the byte at addr */
+void owner(map * m, long addr, char ** section, char ** name)
+{
+    item *it, *in = NULL, *sym = NULL;
+    int i;
+
+    *section = "-";
+    *name = "(gap)";
+    for (i = 0; i < m->count; i++) {
+        it = &m->items[i];
+        if (addr < it->addr)
+            continue;
+        switch (it->type) {
+        case OUTPUT_SECTION:
+            if (addr < it->addr + it->size) {
+                *section = it->name;
+                *name = "(fill)";
+            }
+            break;
+        case FILL:
+            if (addr < it->addr + it->size)
+                in = NULL;
+            break;
+        case INPUT_SECTION:
+            if (addr < it->addr + it->size) {
+                in = it;
+                sym = NULL;
+            }
+            break;
+        case SYMBOL:
+            if (in != NULL && it->addr < in->addr + in->size &&
+                (sym == NULL || it->addr >= sym->addr))
+                sym = it;
+            break;
+        }
+    }
+    if (in != NULL)
+        *name = (sym != NULL) ? sym->name : in->file;
+}
+
+void profile_image(map * m, image * im, profile * p)
+{
+    char *section, *name;
+    long i;
+
+    p->count = 0;
+    p->bytes = im->length;
+    for (i = 0; i < im->length; i++) {
+        owner(m, IMAGE_START + i, &section, &name);
+        find_entry(p, section, name)->bytes++;
+    }
+}
+
+int by_bytes(const void * a, const void * b)
+{
+    const entry *x = a, *y = b;
+    long dx = x->bytes - x->old_bytes, dy = y->bytes - y->old_bytes;
+
+    if (labs(dx) != labs(dy))
+        return labs(dy) > labs(dx) ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+void print_profile(profile * p)
+{
+    double per_byte = image_seconds(p->bytes) / (p->bytes ? p->bytes : 1);
+    int i;
+
+    qsort(p->entries, p->count, sizeof(entry), by_bytes);
+    printf("%7s %8s  %-10s %s\n", "bytes", "seconds", "section", "symbol");
+    for (i = 0; i < p->count; i++)
+        printf("%7ld %8.2f  %-10s %s\n", p->entries[i].bytes,
+               p->entries[i].bytes * per_byte,
+               p->entries[i].section, p->entries[i].name);
+    printf("%7ld %8.2f  total, %d blocks\n", p->bytes,
+           image_seconds(p->bytes),
+           (int)((p->bytes + TRANSFER_SIZE - 1) / TRANSFER_SIZE));
+}
+
+void print_diff(profile * old, profile * new)
+{
+    double per_byte = image_seconds(new->bytes) / (new->bytes ? new->bytes : 1);
+    entry *e;
+    long d;
+    int i;
+
+    for (i = 0; i < old->count; i++) {
+        e = find_entry(new, old->entries[i].section, old->entries[i].name);
+        e->old_bytes = old->entries[i].bytes;
+    }
+
+    qsort(new->entries, new->count, sizeof(entry), by_bytes);
+    printf("%7s %7s %7s %8s  %-10s %s\n",
+           "old", "new", "delta", "seconds", "section", "symbol");
+    for (i = 0; i < new->count; i++) {
+        e = &new->entries[i];
+        if ((d = e->bytes - e->old_bytes) == 0)
+            continue;
+        printf("%7ld %7ld %+7ld %+8.2f  %-10s %s\n", e->old_bytes, e->bytes,
+               d, d * per_byte, e->section, e->name);
+    }
+    printf("%7ld %7ld %+7ld %+8.2f  total\n", old->bytes, new->bytes,
+           new->bytes - old->bytes,
+           image_seconds(new->bytes) - image_seconds(old->bytes));
+}
+
+/* One line per program; returns 1 if one is over budget */
+int print_budget(long budget, int count, char * names[])
+{
+    static image im;
+    int i, over = 0;
+
+    for (i = 0; i < count; i++) {
+        read_image(names[i], &im);
+        printf("%-20s %7d bytes %8.2f s %6.1f%% of %ld%s\n", names[i],
+               im.length, image_seconds(im.length),
+               100.0 * im.length / budget, budget,
+               im.length > budget ? ", over budget" : "");
+        if (im.length > budget)
+            over = 1;
+    }
+    return over;
+}
+
+/*------------------------------------------------------------------------
+ * Zero layout. download sends the image up to its last byte, zeros
+ * included, but not .bss, which crt0.s clears. write_zero_layout copies
+ * the linker script template and replaces its wildcard lines for .data
+ * and .rodata by the input sections of the map that hold nonzero
+ * bytes. The sections that hold only zeros are listed in front of the
+ * .bss wildcard instead. Linking the same objects again with the new
+ * script leaves no zero sections in the image.
+ *------------------------------------------------------------------------
+ */
+#define ZERO_DATA    "*(.data .data.*)"
+#define ZERO_RODATA  "*(.rodata .rodata.*)"
+#define ZERO_BSS     "*(.bss .bss.*)"
+
+/* Input section holding only zeros */
+int zero_section(item * it, image * im)
+{
+    long i;
+
+    for (i = it->addr; i < it->addr + it->size; i++)
+        if (i < IMAGE_START || i >= IMAGE_START + im->length ||
+            im->data[i - IMAGE_START])
+            return 0;
+    return 1;
+}
+
+/* Input section statement of it; "lib.a(m.o)" becomes "lib.a:m.o" */
+void print_section(FILE * out, char * indent, item * it)
+{
+    char file[NAME_LEN], *p;
+
+    strcpy(file, it->file);
+    if ((p = strchr(file, '(')) != NULL) {
+        *p = ':';
+        p[strcspn(p, ")")] = 0;
+    }
+    fprintf(out, "%s%s(%s)\n", indent, file, it->name);
+}
+
+void write_zero_layout(char * template, map * m, image * im)
+{
+    char buf[512], indent[64], *line, *prefix;
+    FILE *file;
+    item *it;
+    int i, sections = 0;
+    long bytes = 0;
+
+    if ((file = fopen(template, "r")) == NULL) {
+        fprintf(stderr, "%s: failed to open\n", template);
+        exit(1);
+    }
+    while (fgets(buf, sizeof(buf), file)) {
+        line = buf + strspn(buf, " \t");
+        snprintf(indent, sizeof(indent), "%.*s", (int)(line - buf), buf);
+        prefix = !strncmp(line, ZERO_DATA, strlen(ZERO_DATA)) ? ".data" :
+                 !strncmp(line, ZERO_RODATA, strlen(ZERO_RODATA)) ? ".rodata" :
+                 NULL;
+        if (prefix != NULL) {
+            for (i = 0; i < m->count; i++) {
+                it = &m->items[i];
+                if (it->type == INPUT_SECTION &&
+                    !strncmp(it->name, prefix, strlen(prefix)) &&
+                    !zero_section(it, im))
+                    print_section(stdout, indent, it);
+            }
+            continue;
+        }
+        if (!strncmp(line, ZERO_BSS, strlen(ZERO_BSS)))
+            for (i = 0; i < m->count; i++) {
+                it = &m->items[i];
+                if (it->type == INPUT_SECTION &&
+                    (!strncmp(it->name, ".data", 5) ||
+                     !strncmp(it->name, ".rodata", 7)) &&
+                    zero_section(it, im)) {
+                    print_section(stdout, indent, it);
+                    sections++;
+                    bytes += it->size;
+                }
+            }
+        fputs(buf, stdout);
+    }
+    fclose(file);
+    fprintf(stderr, "rcxsize: %d zero sections, %ld bytes moved to .bss\n",
+            sections, bytes);
+}
+
+int main(int argc, char * argv[])
+{
+    static map     m;
+    static image   im;
+    static profile old, new;
+    long budget;
+
+    if (argc >= 4 && !strcmp(argv[1], "-b") &&
+        (budget = strtol(argv[2], NULL, 0)) > 0)
+        exit(print_budget(budget, argc - 3, &argv[3]));
+    else if (argc == 5 && !strcmp(argv[1], "-z")) {
+        read_map(argv[3], &m);
+        read_image(argv[4], &im);
+        write_zero_layout(argv[2], &m, &im);
+    }
+    else if (argc == 3) {
+        read_map(argv[1], &m);
+        read_image(argv[2], &im);
+        profile_image(&m, &im, &new);
+        print_profile(&new);
+    }
+    else if (argc == 6 && !strcmp(argv[1], "-d")) {
+        read_map(argv[2], &m);
+        read_image(argv[3], &im);
+        profile_image(&m, &im, &old);
+        read_map(argv[4], &m);
+        read_image(argv[5], &im);
+        profile_image(&m, &im, &new);
+        print_diff(&old, &new);
+    }
+    else {
+        fprintf(stderr, "usage: %s map srec\n", argv[0]);
+        fprintf(stderr, "       %s -d old.map old.srec new.map new.srec\n",
+                argv[0]);
+        fprintf(stderr, "       %s -b budget srec ...\n", argv[0]);
+        fprintf(stderr, "       %s -z template.lds map srec\n", argv[0]);
+        exit(1);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,183 @@
+/* RCX_Sound.h
+ *
+ * Tones played in the background. sound_tone queues a tone and returns
+ * at once. Timer 0 toggles the speaker output on each compare match,
+ * so a playing tone costs no CPU time; the 1 ms tick of RCX_Time.h
+ * counts down its length and starts the next one.
+ *
+ *   time_init();
+ *   sound_init();
+ *   sound_tone(440, 200);
+ *   sound_tone(0, 50);                 rest
+ *   sound_tone(880, 200);
+ *
+ * Timer 0 counts with the fastest of its six clocks that lets the
+ * period fit in 8 bits, which keeps tones from 31 Hz to 8 kHz within
+ * 0.8%.
+ *
+ * The tick hook takes about 60 states in a tick within a tone and
+ * about 150 when it starts one. sound_stat counts the tones started,
+ * the deepest the queue has been and the FRC counts, 2 us each, spent
+ * in the hook while tones were queued.
+ */
+
+#ifndef RCX_SOUND_H
+#define RCX_SOUND_H
+
+#include "RCX_Time.h"
+
+#define SOUND_QUEUE     16              /* power of 2                   */
+
+/* Timer 0 setting and length of a tone; cr 0 is a rest */
+struct sound { byte cr;
+               byte cora;
+               byte icks;
+               uint16 ms;
+             };
+
+/* Timer 0 clocks, fastest first */
+struct sound_clock { uint16 div;
+                     byte cr;
+                     byte icks;
+                   };
+
+const struct sound_clock sound_clock[6] = {
+  {    2, TCR8_CLOCK_8,    STCR_ICKS0 },
+  {    8, TCR8_CLOCK_8,    0          },
+  {   32, TCR8_CLOCK_64,   STCR_ICKS0 },
+  {   64, TCR8_CLOCK_64,   0          },
+  {  256, TCR8_CLOCK_1024, STCR_ICKS0 },
+  { 1024, TCR8_CLOCK_1024, 0          },
+};
+
+struct sound_stat { uint16 tones;
+                    byte high;
+                    uint32 frc;
+                  };
+
+struct sound sound_queue[SOUND_QUEUE];
+volatile byte sound_head;               /* written by the program       */
+volatile byte sound_tail;               /* written by sound_tick        */
+volatile uint16 sound_left;             /* ms left of the current tone  */
+struct sound_stat sound_stat;
+vector sound_next_hook;
+
+static inline void sound_off (void)
+{
+  T0_CR = 0;
+  T0_CSR = 0;
+}
+
+/* Tick hook */
+void sound_tick (void)
+{
+  struct sound *s;
+  uint16 start, end;
+  byte tail;
+
+  if (sound_left == 0 && sound_tail == sound_head)
+    goto next;
+
+  start = T_CNT;
+  if (sound_left == 0 || --sound_left == 0) {
+    tail = sound_tail;
+    if (tail == sound_head)
+      sound_off();
+    else {
+      s = &sound_queue[tail];
+      T0_CR = 0;
+      T0_CNT = 0;
+      T0_CORA = s->cora;
+      STCR = (STCR & ~STCR_ICKS0) | s->icks;
+      T0_CSR = s->cr ? TCSR8_TOGGLE_A : 0;
+      T0_CR = s->cr;
+      sound_left = s->ms;
+      sound_tail = (tail + 1) & (SOUND_QUEUE - 1);
+      sound_stat.tones++;
+    }
+  }
+  end = T_CNT;
+  sound_stat.frc += end >= start ? end - start
+                                 : end + TIME_FRC_PER_MS - start;
+
+next:
+  if (sound_next_hook)
+    sound_next_hook();
+}
+
+/* Start the player. Needs time_init first. */
+void sound_init (void)
+{
+  byte ccr;
+
+  sound_off();
+
+  ccr = irq_save();
+  sound_head = sound_tail = 0;
+  sound_left = 0;
+  sound_next_hook = time_hook;
+  time_hook = sound_tick;
+  irq_restore(ccr);
+}
+
+/* Number of tones queued, besides the one playing */
+static inline byte sound_queued (void)
+{
+  return (sound_head - sound_tail) & (SOUND_QUEUE - 1);
+}
+
+/* Queue a tone of hz for ms milliseconds; hz 0 is a rest. Returns 0 if
+ * the queue is full.
+ */
+byte sound_tone (uint16 hz, uint16 ms)
+{
+  struct sound *s;
+  uint32 count;
+  byte head, next, i;
+
+  head = sound_head;
+  next = (head + 1) & (SOUND_QUEUE - 1);
+  if (next == sound_tail)
+    return 0;
+
+  s = &sound_queue[head];
+  s->ms = ms ? ms : 1;
+  s->cr = 0;
+  s->cora = 0;
+  s->icks = 0;
+
+  /* the output toggles twice per period */
+  if (hz) {
+    for (i = 0; i < 6; i++) {
+      count = (TIME_PHI_HZ / 2 / sound_clock[i].div + hz / 2) / hz;
+      if (count <= 256)
+        break;
+    }
+    if (i == 6) {
+      i = 5;
+      count = 256;
+    }
+    s->cr = TCR8_CLR_A | sound_clock[i].cr;
+    s->icks = sound_clock[i].icks;
+    s->cora = count - 1;
+  }
+
+  sound_head = next;
+  if (sound_queued() > sound_stat.high)
+    sound_stat.high = sound_queued();
+  return 1;
+}
+
+/* Drop the queued tones and stop the one playing */
+void sound_stop (void)
+{
+  byte ccr;
+
+  ccr = irq_save();
+  sound_tail = sound_head;
+  sound_left = 0;
+  sound_off();
+  irq_restore(ccr);
+}
+
+#endif /* RCX_SOUND_H */
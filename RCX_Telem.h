@@ -0,0 +1,184 @@
+/* RCX_Telem.h
+ *
+ * Telemetry: samples of up to TELEM_CHANNELS 16-bit values, packed
+ * into frames that fill the transmit queue of RCX_Serial.h and sent
+ * to the host without being asked for. rcx -t decodes them into a
+ * table with the time of each sample.
+ *
+ *   void log_run (void)
+ *   { uint16 v[3];
+ *
+ *     v[0] = sensor_read(0); v[1] = sensor_read(1); v[2] = sensor_read(2);
+ *     telem_sample(v);
+ *   }
+ *
+ *   telem_init(3);
+ *   task_every(task_create(log_run), 20);
+ *
+ * A record is the time in ticks since the record before as a varint,
+ * then for each channel the change of its value since the record
+ * before, zigzag coded as a varint: 7 bits a byte, low bits first,
+ * bit 7 set in all but the last byte; zigzag maps 0 -1 1 -2 ... to
+ * 0 1 2 3 .... Slowly changing values so take one byte each. The
+ * first record of a frame is a keyframe, coded against time 0 and
+ * values 0, so that every frame decodes on its own and a frame lost
+ * on the link loses only its own samples.
+ *
+ * A frame is 0x49 seq channels records..., the seq counting frames.
+ * One frame is filled while the one before is sent; if that has not
+ * gone out when the next is full, it is dropped and counted in
+ * telem_dropped. At 2400 bit/s a full frame of 29 bytes takes 300 ms
+ * on the link, against 100 ms for a packet with one raw sample of
+ * three channels.
+ *
+ * telem_sample is called by tasks only, not by interrupt handlers.
+ *
+ * Requests, in the format of the helper of download -v:
+ *
+ *   0xb6 on         start or stop sending, reply 0x49
+ */
+
+#ifndef RCX_TELEM_H
+#define RCX_TELEM_H
+
+#include "RCX_Serial.h"
+
+#define TELEM_CHANNELS   6              /* a keyframe fits a frame      */
+#define TELEM_FRAME_MAX  ((SERIAL_TX_SIZE - 1 - 5) / 2)
+#define TELEM_RECORD_MAX (3 + 3 * TELEM_CHANNELS)
+
+#define TELEM_START      0xb6
+#define TELEM_FRAME      0x49           /* ~TELEM_START                 */
+
+struct telem_frame { byte data[TELEM_FRAME_MAX];
+                     byte length;       /* 0 if empty                   */
+                   };
+
+struct telem_frame telem_frame[2];
+byte telem_fill;                        /* frame being filled           */
+byte telem_channels;
+byte telem_seq;
+byte telem_on;
+uint16 telem_time;                      /* of the record before         */
+uint16 telem_value[TELEM_CHANNELS];
+uint16 telem_dropped;                   /* frames                       */
+
+void telem_init (byte channels)
+{
+  telem_channels = channels < TELEM_CHANNELS ? channels : TELEM_CHANNELS;
+  telem_frame[0].length = telem_frame[1].length = 0;
+  telem_fill = 0;
+  telem_seq = 0;
+  telem_dropped = 0;
+  telem_on = 1;
+}
+
+static inline byte *telem_varint (byte *p, uint16 v)
+{
+  while (v >= 0x80) {
+    *p++ = v | 0x80;
+    v >>= 7;
+  }
+  *p++ = v;
+  return p;
+}
+
+static inline uint16 telem_zigzag (uint16 d)
+{
+  return d << 1 ^ -(d >> 15);
+}
+
+/* Queue the full frame unless the one before is still waiting */
+void telem_send (void)
+{
+  struct telem_frame *out = &telem_frame[telem_fill ^ 1];
+
+  if (out->length && serial_send(out->data, out->length))
+    out->length = 0;
+}
+
+/* Finish the frame being filled and start the next */
+void telem_flush (void)
+{
+  struct telem_frame *f = &telem_frame[telem_fill];
+
+  if (!f->length)
+    return;
+  telem_send();
+  if (telem_frame[telem_fill ^ 1].length) {
+    /* Drop it; it is filled next, from a new keyframe */
+    telem_dropped++;
+    telem_frame[telem_fill ^ 1].length = 0;
+  }
+  telem_fill ^= 1;
+  telem_send();
+}
+
+/* Start a frame with the header and a keyframe */
+static void telem_begin (struct telem_frame *f)
+{
+  byte i;
+
+  f->data[0] = TELEM_FRAME;
+  f->data[1] = telem_seq++;
+  f->data[2] = telem_channels;
+  f->length = 3;
+  telem_time = 0;
+  for (i = 0; i < telem_channels; i++)
+    telem_value[i] = 0;
+}
+
+static byte telem_record (byte *p, uint16 t, const uint16 *v)
+{
+  byte *q = p, i;
+
+  q = telem_varint(q, t - telem_time);
+  for (i = 0; i < telem_channels; i++)
+    q = telem_varint(q, telem_zigzag(v[i] - telem_value[i]));
+  return q - p;
+}
+
+/* Add the values v of all channels at the current time */
+void telem_sample (const uint16 *v)
+{
+  struct telem_frame *f = &telem_frame[telem_fill];
+  byte record[TELEM_RECORD_MAX], n, i;
+  uint16 t;
+
+  telem_send();
+  if (!telem_on)
+    return;
+
+  t = time_ticks();
+  if (!f->length)
+    telem_begin(f);
+  n = telem_record(record, t, v);
+  if (f->length + n > TELEM_FRAME_MAX) {
+    telem_flush();
+    f = &telem_frame[telem_fill];
+    telem_begin(f);
+    n = telem_record(record, t, v);
+  }
+  for (i = 0; i < n; i++)
+    f->data[f->length++] = record[i];
+  telem_time = t;
+  for (i = 0; i < telem_channels; i++)
+    telem_value[i] = v[i];
+}
+
+/* Answer a telemetry request. Returns 0 if cmd is not one. */
+byte telem_command (const byte *cmd, byte n)
+{
+  byte reply[1];
+
+  if ((cmd[0] & ~0x08) != TELEM_START)
+    return 0;
+  telem_on = n >= 2 && cmd[1];
+  if (!telem_on)
+    telem_flush();
+  reply[0] = ~cmd[0];
+  serial_send(reply, 1);
+  return 1;
+}
+
+#endif /* RCX_TELEM_H */
@@ -0,0 +1,174 @@
+/* RCX_Time.h
+ *
+ * Time from the free-running timer. The FRC counts phi/32, 2 us at
+ * 16 MHz, and is cleared by compare match A every millisecond, whose
+ * interrupt counts time_msec. Delays measured this way do not depend
+ * on the code of a wait loop, and interrupts during a delay only make
+ * it end late by the length of the handler.
+ *
+ *   time_ms     ms since time_init, wraps after 49 days
+ *   time_us     us since time_init, wraps after 71 minutes
+ *   delay_us    busy wait, 2 us resolution
+ *   delay_ms    sleeps between ticks, needs interrupts enabled
+ *   timeout_*   deadlines up to 32767 ms, usable in interrupt handlers
+ *
+ * Drivers that work every tick set time_hook and call the hook they
+ * replaced from theirs.
+ */
+
+#ifndef RCX_TIME_H
+#define RCX_TIME_H
+
+#include "RCX_H8.h"
+
+#define TIME_PHI_HZ     16000000UL      /* system clock of the RCX      */
+#define TIME_FRC_HZ     (TIME_PHI_HZ / 32)
+#define TIME_FRC_PER_MS ((uint16)(TIME_FRC_HZ / 1000))
+#define TIME_US_PER_FRC ((uint16)(1000000UL / TIME_FRC_HZ))
+
+volatile uint32 time_msec;
+vector time_hook;                       /* called every tick            */
+vector time_old_ocia;
+
+/* Compare match A handler */
+void time_tick (void)
+{
+  T_CSR &= ~TCSR_OCFA;
+  time_msec++;
+  if (time_hook)
+    time_hook();
+}
+
+RCX_HANDLER(time_tick_handler, time_tick);
+
+/* Start the clock at 0 */
+void time_init (void)
+{
+  T_IER &= ~(TIER_OCIAE | TIER_OCIBE | TIER_OVIE);
+
+  time_msec = 0;
+  time_hook = 0;
+  time_old_ocia = ocia_vector;
+  ocia_vector = time_tick_handler;
+
+  T_CR = TCR_CLOCK_32;
+  T_OCR &= ~TOCR_OCRS;
+  T_OCRA = TIME_FRC_PER_MS - 1;
+  T_CSR = TCSR_CCLRA;
+  T_CNT = 0;
+
+  /* sleep must not enter software standby, which stops the timers */
+  SYSCR &= ~SYSCR_SSBY;
+
+  T_IER |= TIER_OCIAE;
+}
+
+/* Stop the clock and give the timer back to the ROM */
+void time_shutdown (void)
+{
+  T_IER &= ~TIER_OCIAE;
+  ocia_vector = time_old_ocia;
+}
+
+/* Low 16 bits of time_msec in one access, without masking interrupts */
+static inline uint16 time_ticks (void)
+{
+  return ((volatile uint16 *)&time_msec)[1];
+}
+
+uint32 time_ms (void)
+{
+  uint32 ms;
+  byte ccr;
+
+  ccr = irq_save();
+  ms = time_msec;
+  irq_restore(ccr);
+  return ms;
+}
+
+uint32 time_us (void)
+{
+  uint32 ms;
+  uint16 frc;
+  byte ccr;
+
+  ccr = irq_save();
+  ms = time_msec;
+  frc = T_CNT;
+  if (T_CSR & TCSR_OCFA) {
+    /* the FRC was cleared but the tick is not counted yet */
+    ms++;
+    frc = T_CNT;
+  }
+  irq_restore(ccr);
+
+  return ms * 1000 + frc * TIME_US_PER_FRC;
+}
+
+/* Wait at least us microseconds */
+void delay_us (uint16 us)
+{
+  uint16 left, prev, frc, elapsed;
+
+  left = us / TIME_US_PER_FRC + (us % TIME_US_PER_FRC != 0);
+  prev = T_CNT;
+
+  while (left) {
+    frc = T_CNT;
+    if (frc >= prev)
+      elapsed = frc - prev;
+    else
+      elapsed = frc + TIME_FRC_PER_MS - prev;
+    if (elapsed >= left)
+      break;
+    left -= elapsed;
+    prev = frc;
+  }
+}
+
+/* Wait at least ms milliseconds. The CPU sleeps until the last tick
+ * before the end and then waits for the FRC.
+ */
+void delay_ms (uint16 ms)
+{
+  uint32 end;
+  int32 left;
+
+  end = time_us() + (uint32)ms * 1000;
+
+  while ((left = (int32)(end - time_us())) > 0) {
+    if (left > 1000) {
+      irq_disable();
+      irq_enable_sleep();
+    } else {
+      delay_us(left);
+      break;
+    }
+  }
+}
+
+/* Deadlines. timeout_start(ms) expires after at least ms and at most
+ * ms + 1 milliseconds.
+ */
+typedef uint16 timeout;
+
+static inline timeout timeout_start (uint16 ms)
+{
+  return time_ticks() + ms;
+}
+
+static inline byte timeout_expired (timeout t)
+{
+  return (int16)(time_ticks() - t) > 0;
+}
+
+/* Milliseconds left, 0 once expired */
+static inline uint16 timeout_left (timeout t)
+{
+  int16 left = (int16)(t - time_ticks()) + 1;
+
+  return left > 0 ? left : 0;
+}
+
+#endif /* RCX_TIME_H */
@@ -0,0 +1,362 @@
+/*
+ *  RCX_Tower.h
+ *
+ *  Discovery of the RS232/USB serial port connected to the infrared
+ *  transmitter/receiver (the "tower"). Included by RCX_Download.c and
+ *  RCX_Request_Reply.c.
+ *
+ *  RCX_tower_name returns the name of the port to open:
+ *
+ *    1. The RCX_IR environment variable, unless it is set to "auto".
+ *    2. The port found by an earlier discovery, cached in the file
+ *       named by RCX_IR_CACHE, default $HOME/.rcx_ir.
+ *    3. The port found by probing every candidate device in parallel.
+ *       The result is written to the cache.
+ *    4. DEFAULT_RCX_IR if no candidate answered.
+ *
+ *  Set RCX_IR=auto to force a new discovery, e.g. after moving the
+ *  tower to another port.
+ *------------------------------------------------------------------------
+ */
+
+#ifndef RCX_TOWER_H
+#define RCX_TOWER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glob.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+
+#if defined(__linux__)
+#define DEFAULT_RCX_IR   "/dev/ttyS0"     /* Linux name of COM1          */
+#elif defined(__sgi)
+#define DEFAULT_RCX_IR   "/dev/ttyd2"     /* SGI name of serial port     */
+#else
+#define DEFAULT_RCX_IR   "/dev/term/a"    /* Solaris name of serial port */
+#endif
+
+#define TOWER_CACHE_FILE  ".rcx_ir"
+#define TOWER_MAX         32     /* max number of candidate devices      */
+#define TOWER_NAME_LEN    256
+#define TOWER_BUF_SIZE    64
+#define TOWER_PINGS       4      /* alive requests sent to each device   */
+#define TOWER_GAP_MS      100    /* silence that ends a reply, as VTIME  */
+#define TOWER_ROUND_MS    400    /* upper bound on one probe round       */
+
+/* Candidate device names. Patterns that match nothing are ignored. */
+static const char *tower_patterns[] = {
+    "/dev/ttyUSB*",         /* Linux USB serial adapters               */
+    "/dev/ttyACM*",         /* Linux CDC-ACM devices                   */
+    "/dev/ttyS*",           /* Linux on-board serial ports             */
+    "/dev/cu.*",            /* Mac OS X serial ports                   */
+    "/dev/term/*",          /* Solaris serial ports                    */
+    "/dev/ttyd*",           /* SGI serial ports                        */
+    NULL
+};
+
+/*------------------------------------------------------------------------
+ * Probe state of a candidate device.
+ *
+ * echoes:  number of alive requests echoed correctly by the tower.
+ * replies: number of alive requests answered correctly by an RCX.
+ * rtt_ms:  sum of the times from request sent to last reply byte
+ *          received, for the requests answered.
+ *------------------------------------------------------------------------
+ */
+struct tower_t { char name[TOWER_NAME_LEN];
+                 int  fd;
+                 unsigned char buf[TOWER_BUF_SIZE];
+                 int  count;
+                 long last_ms;
+                 int  echoes;
+                 int  replies;
+                 long rtt_ms;
+               };
+
+typedef struct tower_t tower;
+
+static long tower_now_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000L + tv.tv_usec / 1000;
+}
+
+/*------------------------------------------------------------------------
+ * tower_open:
+ * Opens a device without blocking on modem lines and sets the same
+ * mode as the tools: 8 bit characters, odd parity, 2400 bit/sec.
+ * Reads return at once. Returns -1 if the device is not a serial port.
+ *------------------------------------------------------------------------
+ */
+static int tower_open(const char *name)
+{
+    int fd;
+    struct termios ios;
+
+    if ((fd = open(name, O_RDWR | O_NOCTTY | O_NONBLOCK)) < 0)
+        return -1;
+
+    if (!isatty(fd)) {
+        close(fd);
+        return -1;
+    }
+
+    memset(&ios, 0, sizeof(ios));
+    ios.c_cflag = CREAD | CLOCAL | CS8 | PARENB | PARODD;
+    cfsetispeed(&ios, B2400);
+    cfsetospeed(&ios, B2400);
+    ios.c_cc[VTIME] = 0;
+    ios.c_cc[VMIN]  = 0;
+
+    if (tcsetattr(fd, TCSANOW, &ios) == -1) {
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+
+    return fd;
+}
+
+/*------------------------------------------------------------------------
+ * tower_alive_packet:
+ * Builds the IR packet of an alive request (opcode 0x10). Bit 3 of
+ * the opcode is toggled between requests, because the RCX ignores a
+ * request identical to the previous one. The reply opcode is the
+ * bit-complement of the request opcode.
+ *------------------------------------------------------------------------
+ */
+static int tower_alive_packet(unsigned char *p, unsigned char op)
+{
+    p[0] = 0x55; p[1] = 0xff; p[2] = 0x00;
+    p[3] = op;   p[4] = ~op;                /* opcode                  */
+    p[5] = op;   p[6] = ~op;                /* checksum = opcode       */
+    return 7;
+}
+
+/*------------------------------------------------------------------------
+ * tower_probe_round:
+ * Sends one alive request to every open device, then collects bytes
+ * from all of them with select until each has been silent for
+ * TOWER_GAP_MS, or TOWER_ROUND_MS has passed. Each device's bytes are
+ * then checked for the echo and for the reply.
+ *------------------------------------------------------------------------
+ */
+static void tower_probe_round(tower *t, int n, unsigned char op)
+{
+    unsigned char req[8], rep[8];
+    int req_len, i, busy, maxfd, count;
+    long start, now;
+    fd_set fds;
+    struct timeval tv;
+
+    req_len = tower_alive_packet(req, op);
+    tower_alive_packet(rep, (unsigned char)~op);
+
+    start = tower_now_ms();
+    for (i = 0; i < n; i++) {
+        t[i].count = 0;
+        t[i].last_ms = start;
+        if (t[i].fd >= 0 && write(t[i].fd, req, req_len) != req_len) {
+            close(t[i].fd);
+            t[i].fd = -1;
+        }
+    }
+
+    do {
+        FD_ZERO(&fds);
+        busy = 0;
+        maxfd = -1;
+        now = tower_now_ms();
+        for (i = 0; i < n; i++)
+            if (t[i].fd >= 0 && t[i].count < TOWER_BUF_SIZE &&
+                now - t[i].last_ms < TOWER_GAP_MS) {
+                FD_SET(t[i].fd, &fds);
+                if (t[i].fd > maxfd)
+                    maxfd = t[i].fd;
+                busy = 1;
+            }
+        if (!busy)
+            break;
+
+        tv.tv_sec  = 0;
+        tv.tv_usec = 10000;
+        if (select(maxfd + 1, &fds, NULL, NULL, &tv) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        now = tower_now_ms();
+        for (i = 0; i < n; i++)
+            if (t[i].fd >= 0 && FD_ISSET(t[i].fd, &fds)) {
+                count = read(t[i].fd, &t[i].buf[t[i].count],
+                             TOWER_BUF_SIZE - t[i].count);
+                if (count > 0) {
+                    t[i].count += count;
+                    t[i].last_ms = now;
+                }
+            }
+    } while (now - start < TOWER_ROUND_MS);
+
+    /* Echo first, then reply */
+    for (i = 0; i < n; i++) {
+        if (t[i].fd < 0 || t[i].count < req_len ||
+            memcmp(t[i].buf, req, req_len) != 0)
+            continue;
+        t[i].echoes++;
+        if (t[i].count >= req_len + 7 &&
+            memcmp(&t[i].buf[req_len], rep, 7) == 0) {
+            t[i].replies++;
+            t[i].rtt_ms += t[i].last_ms - start;
+        }
+    }
+}
+
+/*------------------------------------------------------------------------
+ * tower_better:
+ * Orders two probed devices. An answering RCX beats an echo only,
+ * more answers beat fewer, and a shorter round-trip time breaks ties.
+ *------------------------------------------------------------------------
+ */
+static int tower_better(tower *a, tower *b)
+{
+    if (a->replies != b->replies)
+        return a->replies > b->replies;
+    if (a->echoes != b->echoes)
+        return a->echoes > b->echoes;
+    return a->rtt_ms * (b->replies + 1) < b->rtt_ms * (a->replies + 1);
+}
+
+static char *tower_cache_name(char *name, int size)
+{
+    char *s;
+
+    if ((s = getenv("RCX_IR_CACHE")) != NULL)
+        snprintf(name, size, "%s", s);
+    else if ((s = getenv("HOME")) != NULL)
+        snprintf(name, size, "%s/%s", s, TOWER_CACHE_FILE);
+    else
+        return NULL;
+    return name;
+}
+
+static int tower_cache_read(char *dev, int size)
+{
+    char file[TOWER_NAME_LEN];
+    FILE *f;
+    int len;
+
+    if (tower_cache_name(file, sizeof(file)) == NULL ||
+        (f = fopen(file, "r")) == NULL)
+        return 0;
+    if (fgets(dev, size, f) == NULL)
+        dev[0] = 0;
+    fclose(f);
+
+    len = strlen(dev);
+    while (len > 0 && (dev[len-1] == '\n' || dev[len-1] == '\r'))
+        dev[--len] = 0;
+
+    /* A stale entry, e.g. an unplugged USB tower, is not used */
+    return len > 0 && access(dev, R_OK | W_OK) == 0;
+}
+
+static void tower_cache_write(const char *dev)
+{
+    char file[TOWER_NAME_LEN];
+    FILE *f;
+
+    if (tower_cache_name(file, sizeof(file)) == NULL ||
+        (f = fopen(file, "w")) == NULL)
+        return;
+    fprintf(f, "%s\n", dev);
+    fclose(f);
+}
+
+/*------------------------------------------------------------------------
+ * tower_discover:
+ * Probes all candidate devices in parallel, prints the link quality
+ * of every device that echoed, and copies the name of the best one
+ * to dev. Returns 0 if no device echoed.
+ *------------------------------------------------------------------------
+ */
+static int tower_discover(char *dev, int size)
+{
+    static tower t[TOWER_MAX];
+    glob_t g;
+    int n, i, k, best;
+    size_t j;
+
+    n = 0;
+    for (k = 0; tower_patterns[k] != NULL; k++) {
+        if (glob(tower_patterns[k], 0, NULL, &g) != 0)
+            continue;
+        for (j = 0; j < g.gl_pathc && n < TOWER_MAX; j++) {
+            memset(&t[n], 0, sizeof(tower));
+            snprintf(t[n].name, TOWER_NAME_LEN, "%s", g.gl_pathv[j]);
+            if ((t[n].fd = tower_open(t[n].name)) >= 0)
+                n++;
+        }
+        globfree(&g);
+    }
+
+    for (k = 0; k < TOWER_PINGS; k++)
+        tower_probe_round(t, n, (k & 1) ? 0x18 : 0x10);
+
+    best = -1;
+    for (i = 0; i < n; i++) {
+        if (t[i].fd >= 0)
+            close(t[i].fd);
+        if (t[i].echoes == 0)
+            continue;
+        fprintf(stderr, "%s: echo %d/%d, RCX %d/%d",
+                t[i].name, t[i].echoes, TOWER_PINGS, t[i].replies, TOWER_PINGS);
+        if (t[i].replies > 0)
+            fprintf(stderr, ", %ld ms", t[i].rtt_ms / t[i].replies);
+        fprintf(stderr, "\n");
+        if (best < 0 || tower_better(&t[i], &t[best]))
+            best = i;
+    }
+
+    if (best < 0)
+        return 0;
+    snprintf(dev, size, "%s", t[best].name);
+    return 1;
+}
+
+/*------------------------------------------------------------------------
+ * RCX_tower_name:
+ * Returns the name of the port connected to the tower, see above.
+ *------------------------------------------------------------------------
+ */
+char *RCX_tower_name(void)
+{
+    static char dev[TOWER_NAME_LEN];
+    char *s;
+
+    s = getenv("RCX_IR");
+    if (s != NULL && strcmp(s, "auto") != 0)
+        return s;
+
+    if (s == NULL && tower_cache_read(dev, sizeof(dev)))
+        return dev;
+
+    if (tower_discover(dev, sizeof(dev))) {
+        tower_cache_write(dev);
+        return dev;
+    }
+
+    fprintf(stderr, "No IR tower found, using %s.\n", DEFAULT_RCX_IR);
+    return DEFAULT_RCX_IR;
+}
+
+#endif /* RCX_TOWER_H */
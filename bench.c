@@ -0,0 +1,181 @@
+/* bench.c
+ *
+ * Microbenchmarks of the ROM routines of RCX_RTE.h and of runtime
+ * primitives. Each routine is called calls times between two readings
+ * of time_us, and the time of as many calls of an empty function is
+ * subtracted. The results are in states per call, 16 per us.
+ *
+ * Afterwards the results are shown one after the other for two
+ * seconds each: the digit right of the man is the number of the
+ * benchmark, plus 10 when the datalog indicator is on, the number its
+ * time in us. rcxbench reads the whole table over IR:
+ *
+ *   0x86 index      reply 0x79 index count calls(2) states(4) name
+ *
+ * bit 3 of the opcode ignored, values low byte first. An index past
+ * the last benchmark is answered with index and count only.
+ *
+ * The 1 ms tick keeps running during the measurements and adds about
+ * 100 states per ms, under 1%, to each result.
+ *
+ * Linked with crt0.o and rcx.lds.
+ */
+
+#include "RCX_Serial.h"
+#include "RCX_LCD.h"
+#include "RCX_Mem.h"
+#include "RCX_Fixed.h"
+#include "RCX_Alloc.h"
+#include "RCX_Motor.h"
+
+#define BENCH_REQUEST   0x86
+#define BENCH_NAME      12
+#define BENCH_SHOW_MS   2000
+#define BENCH_TENTHS    0x3003          /* scalecode, one decimal       */
+#define BENCH_UNITS     0x3002          /* scalecode, no decimal        */
+#define BENCH_TENS      LCD_DATALOG     /* 10 more than the digit       */
+
+struct bench { char name[BENCH_NAME];
+               void (*run)(void);
+               uint16 calls;
+               uint32 states;
+             };
+
+byte bench_a[64], bench_b[64];
+volatile q16_16 bench_q;
+volatile uint32 bench_u;
+
+void b_empty (void)      { }
+void b_show_icon (void)  { lcd_set_icon(LCD_WALKING); }
+void b_hide_icon (void)  { lcd_reset_icon(LCD_WALKING); }
+void b_show_num (void)   { lcd_set_number(LCD_FB_INT16, 1234, BENCH_UNITS); }
+void b_clear (void)      { lcd_reset(); }
+void b_refresh (void)    { lcd_update(); }
+void b_flush (void)      { lcd_fb_flush(); }
+void b_memcpy (void)     { memcpy(bench_a, bench_b, 64); }
+void b_memset (void)     { memset(bench_a, 0x55, 64); }
+void b_q16_mul (void)    { bench_q = q16_mul(bench_q | 0x18000L, 0x24000L); }
+void b_q16_div (void)    { bench_q = q16_div(0x123456L, bench_q | 0x18000L); }
+void b_q8_sin (void)     { bench_q = q8_sin((byte)bench_q); }
+void b_isqrt32 (void)    { bench_q = isqrt32(bench_u | 0x12345678L); }
+void b_pool (void)       { pool_free(pool_alloc(0)); }
+void b_time_us (void)    { bench_u = time_us(); }
+void b_sched_poll (void) { sched_poll(); }
+void b_motor_tick (void) { motor_tick(); }
+
+struct bench bench[] = {
+  { "show_icon",  b_show_icon,  200 },
+  { "hide_icon",  b_hide_icon,  200 },
+  { "show_num",   b_show_num,   200 },
+  { "clear",      b_clear,      200 },
+  { "refresh",    b_refresh,     50 },
+  { "lcd_flush",  b_flush,     1000 },
+  { "memcpy64",   b_memcpy,    1000 },
+  { "memset64",   b_memset,    1000 },
+  { "q16_mul",    b_q16_mul,   1000 },
+  { "q16_div",    b_q16_div,    500 },
+  { "q8_sin",     b_q8_sin,    1000 },
+  { "isqrt32",    b_isqrt32,    500 },
+  { "pool",       b_pool,      1000 },
+  { "time_us",    b_time_us,   1000 },
+  { "sched_poll", b_sched_poll, 1000 },
+  { "motor_tick", b_motor_tick, 1000 },
+};
+
+#define BENCHES (sizeof(bench) / sizeof(bench[0]))
+
+/* The LCD shows at most 20 */
+typedef char bench_count_check[BENCHES <= 20 ? 1 : -1];
+
+byte bench_shown;
+
+/* us for calls calls of run */
+uint32 bench_time (void (*run)(void), uint16 calls)
+{
+  uint32 start;
+  uint16 i;
+
+  start = time_us();
+  for (i = 0; i < calls; i++)
+    run();
+  return time_us() - start;
+}
+
+void bench_all (void)
+{
+  struct bench *b;
+  uint32 t, empty;
+
+  for (b = bench; b < &bench[BENCHES]; b++) {
+    t = bench_time(b->run, b->calls);
+    empty = bench_time(b_empty, b->calls);
+    b->states = t > empty ? udiv32_16((t - empty) * 16, b->calls) : 0;
+  }
+}
+
+/* Show the next result */
+void show_run (void)
+{
+  uint32 tenths = bench[bench_shown].states * 10 / 16;
+
+  lcd_reset();
+  lcd_set_number(LCD_FB_DIGIT, bench_shown % 10, 0);
+  if (bench_shown >= 10)
+    lcd_set_icon(BENCH_TENS);
+  if (tenths < 10000)
+    lcd_set_number(LCD_FB_INT16, tenths, BENCH_TENTHS);
+  else
+    lcd_set_number(LCD_FB_INT16, tenths < 100000 ? tenths / 10 : 9999,
+                   BENCH_UNITS);
+  lcd_update();
+
+  if (++bench_shown == BENCHES)
+    bench_shown = 0;
+}
+
+void bench_reply (byte op, byte index)
+{
+  byte reply[3 + 2 + 4 + BENCH_NAME], *p;
+  struct bench *b;
+  const char *s;
+
+  reply[0] = ~op;
+  reply[1] = index;
+  reply[2] = BENCHES;
+  p = &reply[3];
+  if (index < BENCHES) {
+    b = &bench[index];
+    *p++ = b->calls;
+    *p++ = b->calls >> 8;
+    *p++ = b->states;
+    *p++ = b->states >> 8;
+    *p++ = b->states >> 16;
+    *p++ = b->states >> 24;
+    for (s = b->name; *s; s++)
+      *p++ = *s;
+  }
+  serial_send(reply, p - reply);
+}
+
+void command_run (void)
+{
+  byte cmd[SERIAL_PACKET_MAX], n;
+
+  while ((n = serial_packet(cmd, sizeof(cmd))) != 0)
+    if ((cmd[0] & ~0x08) == BENCH_REQUEST && n >= 2)
+      bench_reply(cmd[0], cmd[1]);
+}
+
+int main (void)
+{
+  sched_init();
+  alloc_init();
+  lcd_fb_init();
+  lcd_fb_flush();
+  bench_all();
+
+  serial_init(task_create(command_run));
+  task_every(task_create(show_run), BENCH_SHOW_MS);
+  sched_run();
+  return 0;
+}
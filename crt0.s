@@ -0,0 +1,69 @@
+;;; crt0.s
+;;;
+;;; Startup code for C programs. Link it first, so that __start is at
+;;; the load address 0x8000 where download starts the image:
+;;;
+;;;   h8300-hms-ld -Trcx.lds crt0.o program.o
+;;;
+;;; Sets the stack pointer to __stack, clears .bss and calls main.
+;;; When main returns the RCX is reset through the reset vector, as by
+;;; RCX_Reset. .data is downloaded where it is used; a cold start at
+;;; __start copies it to __data_copy and clears .noinit as well.
+;;;
+;;; __restart, 2 bytes behind __start, is the warm restart of
+;;; RCX_Restart.h: it puts the copy back into .data and clears .bss,
+;;; but not .noinit, so the program starts again as downloaded.
+;;;
+;;; rcx.lds aligns all these to words, so they are copied and cleared
+;;; a word at a time; .bss from the end with pre-decrement.
+
+	.section .init,"x"
+	.align 1
+	.global __start
+	.global __restart
+__start:
+	bra	cold
+__restart:
+	mov.w	#__stack, r7
+	mov.w	#__data_copy, r0
+	mov.w	#__data_start, r1
+	mov.w	#__data_end, r2
+	bra	restore_test
+restore:
+	mov.w	@r0+, r3
+	mov.w	r3, @r1
+	adds	#2, r1
+restore_test:
+	cmp.w	r2, r1
+	bcs	restore
+	mov.w	#__bss_end, r1
+	bra	clear_bss
+
+cold:
+	mov.w	#__stack, r7
+	mov.w	#__data_start, r0
+	mov.w	#__data_copy, r1
+	mov.w	#__data_end, r2
+	bra	save_test
+save:
+	mov.w	@r0+, r3
+	mov.w	r3, @r1
+	adds	#2, r1
+save_test:
+	cmp.w	r2, r0
+	bcs	save
+	mov.w	#__noinit_end, r1
+
+clear_bss:
+	mov.w	#__bss_start, r0
+	sub.w	r2, r2
+	bra	clear_test
+clear:
+	mov.w	r2, @-r1
+clear_test:
+	cmp.w	r0, r1
+	bhi	clear
+	jsr	@_main
+	jmp	@@0
+
+	.end
@@ -0,0 +1,111 @@
+/* launch.c
+ *
+ * The launcher of a bundle, see RCX_Launch.h and BUNDLE in the
+ * Makefile. It stays in memory at 0x8000 while the programs of the
+ * bundle run and takes the hardware back from each before starting
+ * the next, with the copy of the ROM's state that main takes first.
+ *
+ * The right digit of the LCD is the selected program, from 1. Prgm
+ * selects the next, Run starts it; the host starts any with 0xf6 n.
+ *
+ * bundle.h, written by the Makefile, defines LAUNCH_ENTRIES, the load
+ * addresses of the programs. Linked with launch0.o, crt0.o and rcx.lds.
+ */
+
+#include "RCX_Serial.h"
+#include "RCX_LCD.h"
+#include "RCX_Boot.h"
+#include "RCX_Launch.h"
+#include "bundle.h"
+
+#define LAUNCH_PROGRAMS (sizeof((uint16 []){ LAUNCH_ENTRIES }) / 2)
+
+/* The table has room for LAUNCH_MAX; a longer BUNDLE fails here */
+typedef char launch_count_check[LAUNCH_PROGRAMS <= LAUNCH_MAX ? 1 : -1];
+
+const uint16 launch_entry[LAUNCH_MAX] = { LAUNCH_ENTRIES };
+
+struct boot launch_boot;
+byte launch_started[LAUNCH_MAX];
+byte launch_selected;
+byte launch_prgm_down;
+
+void launch_menu (void);
+
+/* Called through launch0.s, by launch of RCX_Launch.h */
+void launch_switch (byte n)
+{
+  uint16 entry;
+
+  irq_disable();
+  boot_restore(&launch_boot);
+
+  if (n < LAUNCH_PROGRAMS) {
+    launch_selected = n;
+    entry = launch_entry[n];
+    if (launch_started[n])
+      entry += LAUNCH_WARM;
+    launch_started[n] = 1;
+  } else
+    entry = (uint16)launch_menu;
+
+  /* Start on an empty stack; the entry does not return */
+  asm volatile ("mov.w #__stack,r7\n\t"
+                "andc #0x7f,ccr\n\t"
+                "jmp @%0" : : "r" (entry));
+  for (;;)
+    ;
+}
+
+void launch_show (void)
+{
+  lcd_reset();
+  lcd_set_number(LCD_FB_DIGIT, launch_selected + 1, 0);
+  lcd_update();
+}
+
+void launch_buttons (void)
+{
+  byte state = button_state();
+  byte prgm = (state & BUTTON_PRGM) != 0, run = (state & BUTTON_RUN) != 0;
+
+  if (prgm && !launch_prgm_down) {
+    if (++launch_selected == LAUNCH_PROGRAMS)
+      launch_selected = 0;
+    launch_show();
+  }
+  launch_prgm_down = prgm;
+
+  if (run && !launch_run_down)
+    launch(launch_selected);
+  launch_run_down = run;
+}
+
+void command_run (void)
+{
+  byte cmd[SERIAL_PACKET_MAX], n;
+
+  while ((n = serial_packet(cmd, sizeof(cmd))) != 0)
+    launch_command(cmd, n);
+}
+
+/* Wait for a button or the host. The buttons count once released. */
+void launch_menu (void)
+{
+  sched_init();
+  serial_init(task_create(command_run));
+
+  launch_run_down = (button_state() & BUTTON_RUN) != 0;
+  launch_prgm_down = (button_state() & BUTTON_PRGM) != 0;
+  task_every(task_create(launch_buttons), LAUNCH_POLL_MS);
+
+  launch_show();
+  sched_run();
+}
+
+int main (void)
+{
+  boot_save(&launch_boot);
+  launch_menu();
+  return 0;
+}
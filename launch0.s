@@ -0,0 +1,17 @@
+;;; launch0.s
+;;;
+;;; The jump into the launcher launch.c at the load address, for the
+;;; programs of a bundle, see RCX_Launch.h. Link it before crt0.o:
+;;;
+;;;   h8300-hms-ld -Trcx.lds launch0.o crt0.o launch.o
+;;;
+;;; download starts the launcher at __start, the entry of rcx.lds,
+;;; right behind the jump.
+
+	.section .init,"x"
+	.align 1
+	.global __launch
+__launch:
+	jmp	@_launch_switch
+
+	.end
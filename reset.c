@@ -1,5 +1,7 @@
 #include "RCX_RTE.h"
 
-void _start(void) {
+/* Started by crt0.s */
+int main(void) {
   RCX_Reset();
+  return 0;
 } 
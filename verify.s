@@ -0,0 +1,200 @@
+;;; verify.s
+;;;
+;;; Resident read-back helper for download -v. download appends the
+;;; assembled helper behind the image, starts the helper instead of
+;;; the image, checks the image against the host copy block by block
+;;; and finally tells the helper to start the image.
+;;;
+;;; The helper answers requests in the same IR packet format as the
+;;; ROM, 0x55 0xff 0x00 followed by byte/complement pairs and a
+;;; checksum pair, by polling the serial interface:
+;;;
+;;;   0x10                          alive       reply 0xef
+;;;   0x26 addr(2) size count       block crc   reply 0xd9 crc(2) ...
+;;;   0x36 addr(2) len 0 data(len)  write       reply 0xc9
+;;;   0x46 addr(2) 0 0              run         reply 0xb9, jmp addr
+;;;
+;;; Bit 3 of the opcode is ignored. Other opcodes are acknowledged
+;;; and ignored. The crc is CRC-16-CCITT (polynomial 0x1021, initial
+;;; value 0xffff) of each of count blocks of size bytes from addr,
+;;; low byte first.
+;;;
+;;; The code is position independent: it only uses bsr and branches
+;;; within the helper, which are all shorter than 128 bytes, and keeps
+;;; no data in memory. Do not reorder the routines.
+;;;
+;;; Registers: r0 scratch, r1l opcode, r1 crc, r2l size or length,
+;;; r2h count, r3l request checksum, r3h reply checksum, r5 address,
+;;; r6h opcode as received, r6l byte count.
+
+	.section .text
+	.align 1
+
+;;; getb: wait for a byte from the serial interface and return it in
+;;; r0l. Overrun, framing and parity errors are cleared and skipped.
+getb:
+	mov.b	@0xffdc:8, r0l	; SSR
+	btst	#6, r0l		; RDRF
+	bne	getb_rdr
+	and.b	#0xc7, r0l	; clear ORER, FER and PER
+	mov.b	r0l, @0xffdc:8
+	bra	getb
+getb_rdr:
+	mov.b	@0xffdd:8, r0l	; RDR
+	bclr	#6, @0xffdc:8	; clear RDRF
+	rts
+
+;;; getsum: receive the checksum pair and compare it with the sum of
+;;; the request bytes. Carry is set on error.
+getsum:
+	mov.b	r3l, r1h
+	bsr	getp
+	bcs	getsum_end
+	cmp.b	r1h, r0l
+	beq	getsum_end
+	orc	#0x01, ccr
+getsum_end:
+	rts
+
+;;; getp: receive a byte and its complement, return the byte in r0l
+;;; and add it to r3l. Carry is set if the pair does not match.
+getp:
+	bsr	getb
+	mov.b	r0l, r0h
+	bsr	getb
+	not	r0l
+	cmp.b	r0h, r0l
+	bne	getp_bad
+	add.b	r0l, r3l
+	andc	#0xfe, ccr
+	rts
+getp_bad:
+	orc	#0x01, ccr
+	rts
+
+	.global __start
+__start:
+	bclr	#6, @0xffda:8	; SCR: receive by polling, not by the ROM
+request:
+	bsr	getb
+	cmp.b	#0x55, r0l
+	bne	request
+	bsr	getb
+	cmp.b	#0xff, r0l
+	bne	request
+	bsr	getb
+	cmp.b	#0x00, r0l
+	bne	request
+	sub.b	r3l, r3l
+	bsr	getp
+	bcs	request
+	mov.b	r0l, r6h
+	and.b	#0xf7, r0l	; ignore the toggle bit
+	mov.b	r0l, r1l
+	cmp.b	#0x10, r0l
+	beq	check		; alive has no parameters
+	bsr	getp
+	bcs	request
+	mov.b	r0l, r5l
+	bsr	getp
+	bcs	request
+	mov.b	r0l, r5h
+	bsr	getp
+	bcs	request
+	mov.b	r0l, r2l
+	bsr	getp
+	bcs	request
+	mov.b	r0l, r2h
+	cmp.b	#0x36, r1l
+	bne	check
+write:
+	bsr	getp
+	bcs	request
+	mov.b	r0l, @r5
+	adds	#1, r5
+	dec	r2l
+	bne	write
+check:
+	bsr	getsum
+	bcs	request
+	bsr	reply
+	cmp.b	#0x26, r1l
+	beq	crc
+	bsr	endreply
+	cmp.b	#0x46, r1l
+	bne	request
+	bset	#6, @0xffda:8	; give receiving back to the ROM
+	jmp	@r5
+crc:
+	mov.b	r2l, r6l
+	bsr	crc16
+	mov.b	r1l, r0l
+	bsr	putp
+	mov.b	r1h, r0l
+	bsr	putp
+	dec	r2h
+	bne	crc
+	bsr	endreply
+	bra	request
+
+;;; reply: switch the receiver off, so the RCX does not hear itself,
+;;; and send the header and the complemented opcode.
+reply:
+	bclr	#4, @0xffda:8	; SCR: RE off
+	mov.b	#0x55, r0l
+	bsr	putb
+	mov.b	#0xff, r0l
+	bsr	putb
+	sub.b	r0l, r0l
+	bsr	putb
+	sub.b	r3h, r3h
+	mov.b	r6h, r0l
+	not	r0l
+	bra	putp
+
+;;; endreply: send the checksum pair, wait for the last bit to leave
+;;; and switch the receiver on again.
+endreply:
+	mov.b	r3h, r0l
+	bsr	putp
+endreply_tend:
+	btst	#2, @0xffdc:8	; TEND
+	beq	endreply_tend
+	bclr	#6, @0xffdc:8	; drop anything received meanwhile
+	bset	#4, @0xffda:8	; SCR: RE on
+	rts
+
+;;; putp: send r0l and its complement, add r0l to r3h.
+putp:
+	add.b	r0l, r3h
+	bsr	putb
+	not	r0l
+;;; putb: send r0l.
+putb:
+	btst	#7, @0xffdc:8	; TDRE
+	beq	putb
+	mov.b	r0l, @0xffdb:8	; TDR
+	bclr	#7, @0xffdc:8
+	rts
+
+;;; crc16: r1 = CRC-16-CCITT of r6l bytes from r5, r5 is advanced.
+crc16:
+	mov.w	#0xffff:16, r1
+crc16_byte:
+	mov.b	@r5+, r0l
+	xor.b	r0l, r1h
+	mov.b	#8, r6h
+crc16_bit:
+	shll	r1l
+	rotxl	r1h
+	bcc	crc16_next
+	xor.b	#0x10, r1h
+	xor.b	#0x21, r1l
+crc16_next:
+	dec	r6h
+	bne	crc16_bit
+	dec	r6l
+	bne	crc16_byte
+	rts
+
+	.end